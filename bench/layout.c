@@ -0,0 +1,303 @@
+// Widget layout and drawing benchmarks.
+//
+// Usage: ./layout [--wayland] [rand|deep] [NUM_WIDGETS ...]
+//
+// With no arguments this runs both random and deep widget trees with
+// 1000, 10000, and 100000 widgets.  It prints one line of JSON for each
+// measurement, so the output of different versions of libpanels.so can
+// be saved and compared by scripts.  All times are in nanoseconds.
+//
+// We measure:
+//
+//   relayout:  frames that redo all the widget allocations and draw all
+//              the widgets; _pnWidget_getAllocations() is "layout" and
+//              pnSurface_draw() is "draw".
+//
+//   queue:     frames that draw a few random leaf widgets from the draw
+//              queue; that's DrawFromQueue().
+//
+//   find:      finding the widget at a random position in the window,
+//              like we do for every pointer motion event; that's
+//              FindWidget() and the window's find index.
+//
+// The layout, draw, and commit times come from pnWindow_getFrameStats().
+//
+// It runs in headless mode, so it needs no Wayland compositor, and the
+// compositor and the monitor refresh are kept out of the numbers.  With
+// --wayland it uses the Wayland compositor, so the commit times include
+// it.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+// For a given seed we get different repeatable results.
+#define SEED            (3)
+// We get percentiles from this many frames, which is all the frames that
+// pnWindow_getFrameStats() keeps.
+#define NUM_FRAMES      (128)
+// Leaf widgets queued per frame in the "queue" benchmark.
+#define NUM_QUEUED      (8)
+// Number of widget finds per sample, and samples, in the "find"
+// benchmark.
+#define FIND_BATCH      (1000)
+#define FIND_SAMPLES    (128)
+// The deep tree is made of nested container chains this deep.
+#define DEPTH           (200)
+
+#define WIDTH           (1024)
+#define HEIGHT          (768)
+
+
+static void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+
+static struct PnWidget **leaves = 0;
+static uint32_t numLeaves = 0;
+
+
+static inline uint32_t Color(void) {
+    return 0xFF000000 | ((rand() >> 1) & 0xFFFFFF);
+}
+
+static struct PnWidget *Leaf(struct PnWidget *parent) {
+
+    struct PnWidget *w = pnWidget_create(parent,
+            2 + rand() % 5/*width*/, 2 + rand() % 5/*height*/,
+            PnLayout_None, 0/*align*/, rand() % 4/*expand*/, 0);
+    ASSERT(w);
+    pnWidget_setBackgroundColor(w, Color(), 0);
+    leaves[numLeaves++] = w;
+    return w;
+}
+
+static struct PnWidget *Container(struct PnWidget *parent,
+        enum PnLayout layout) {
+
+    struct PnWidget *w = pnWidget_create(parent,
+            rand() % 2/*border width*/, rand() % 2/*border height*/,
+            layout, rand() % 16/*align*/, rand() % 4/*expand*/, 0);
+    ASSERT(w);
+    pnWidget_setBackgroundColor(w, Color(), 0);
+    return w;
+}
+
+
+// Random containers with random numbers of children.
+//
+static void RandTree(struct PnWidget *win, uint32_t num) {
+
+#define MAX_CONTAINERS  (64)
+    struct PnWidget *containers[MAX_CONTAINERS];
+    uint32_t numContainers = 1;
+    containers[0] = win;
+
+    for(uint32_t i = 0; i < num; ++i) {
+        struct PnWidget *parent = containers[rand() % numContainers];
+        if(rand() % 8) {
+            Leaf(parent);
+            continue;
+        }
+        struct PnWidget *c = Container(parent,
+                (rand() % 2) ? PnLayout_LR : PnLayout_TB);
+        // We need leaf widgets in the containers so that they are not
+        // culled.
+        Leaf(c);
+        ++i;
+        if(numContainers < MAX_CONTAINERS)
+            containers[numContainers++] = c;
+        else
+            containers[rand() % MAX_CONTAINERS] = c;
+    }
+#undef MAX_CONTAINERS
+}
+
+
+// Chains of containers DEPTH deep, each with a leaf and the next
+// container in the chain.
+//
+static void DeepTree(struct PnWidget *win, uint32_t num) {
+
+    uint32_t i = 0;
+
+    while(i < num) {
+        struct PnWidget *parent = win;
+        for(uint32_t depth = 0; depth < DEPTH && i < num; ++depth) {
+            parent = Container(parent,
+                    (depth % 2) ? PnLayout_LR : PnLayout_TB);
+            Leaf(parent);
+            i += 2;
+        }
+    }
+}
+
+
+static inline uint64_t Now(void) {
+    struct timespec t;
+    ASSERT(0 == clock_gettime(CLOCK_MONOTONIC, &t));
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+// Wait for the window to draw a frame.
+//
+static void Frame(struct PnWidget *win) {
+
+    pnWindow_isDrawnReset(win);
+    while(!pnWindow_isDrawn(win))
+        ASSERT(pnDisplay_dispatch());
+}
+
+
+static void Print(const char *bench, const char *tree, uint32_t num,
+        const char *stat, uint32_t numSamples,
+        const struct PnStatSummary *s) {
+
+    printf("{\"bench\":\"%s\",\"tree\":\"%s\",\"widgets\":%" PRIu32
+            ",\"stat\":\"%s\",\"samples\":%" PRIu32
+            ",\"p50\":%" PRIu64 ",\"p90\":%" PRIu64
+            ",\"p99\":%" PRIu64 ",\"max\":%" PRIu64 "}\n",
+            bench, tree, num, stat, numSamples,
+            s->p50, s->p90, s->p99, s->max);
+    fflush(stdout);
+}
+
+
+static int Compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+static void Find(struct PnWidget *win, const char *tree, uint32_t num) {
+
+    struct PnAllocation a;
+    pnWidget_getAllocation(win, &a);
+    ASSERT(a.width && a.height);
+
+    uint64_t t[FIND_SAMPLES];
+    int32_t x[FIND_BATCH], y[FIND_BATCH];
+    // So the compiler can't toss the finds.
+    uint32_t found = 0;
+
+    for(uint32_t i = 0; i < FIND_SAMPLES; ++i) {
+        for(uint32_t j = 0; j < FIND_BATCH; ++j) {
+            x[j] = rand() % a.width;
+            y[j] = rand() % a.height;
+        }
+        uint64_t t0 = Now();
+        for(uint32_t j = 0; j < FIND_BATCH; ++j)
+            if(pnWindow_getWidgetAt(win, x[j], y[j]))
+                ++found;
+        // Time per find.
+        t[i] = (Now() - t0)/FIND_BATCH;
+    }
+    ASSERT(found == FIND_SAMPLES * FIND_BATCH);
+
+    qsort(t, FIND_SAMPLES, sizeof(*t), Compare);
+    struct PnStatSummary s = {
+        .p50 = t[(FIND_SAMPLES * 50 - 1)/100],
+        .p90 = t[(FIND_SAMPLES * 90 - 1)/100],
+        .p99 = t[(FIND_SAMPLES * 99 - 1)/100],
+        .max = t[FIND_SAMPLES - 1]
+    };
+    Print("find", tree, num, "find", FIND_SAMPLES, &s);
+}
+
+
+static void Bench(const char *tree, uint32_t num) {
+
+    srand(SEED);
+
+    struct PnWidget *win = pnWindow_create(0, 0/*width*/, 0/*height*/,
+            0/*x*/, 0/*y*/, PnLayout_LR/*layout*/,
+            0/*align*/, PnExpand_HV);
+    ASSERT(win);
+    pnWindow_setPreferredSize(win, WIDTH, HEIGHT);
+    pnWidget_setBackgroundColor(win, 0xFF000000, 0);
+
+    leaves = calloc(num + 1, sizeof(*leaves));
+    ASSERT(leaves, "calloc(%" PRIu32 ",%zu) failed",
+            num + 1, sizeof(*leaves));
+    numLeaves = 0;
+
+    if(!strcmp(tree, "deep"))
+        DeepTree(win, num);
+    else
+        RandTree(win, num);
+
+    ASSERT(0 == pnWindow_show(win));
+    Frame(win);
+
+    struct PnFrameStats stats;
+
+    for(uint32_t i = 0; i < NUM_FRAMES; ++i) {
+        pnWidget_queueDraw(win, true/*allocate*/);
+        Frame(win);
+    }
+    pnWindow_getFrameStats(win, &stats);
+    Print("relayout", tree, num, "layout", stats.numSamples,
+            &stats.layout);
+    Print("relayout", tree, num, "draw", stats.numSamples, &stats.draw);
+    Print("relayout", tree, num, "commit", stats.numSamples,
+            &stats.commit);
+
+    for(uint32_t i = 0; i < NUM_FRAMES; ++i) {
+        for(uint32_t j = 0; j < NUM_QUEUED; ++j)
+            pnWidget_queueDraw(leaves[rand() % numLeaves], false);
+        Frame(win);
+    }
+    pnWindow_getFrameStats(win, &stats);
+    Print("queue", tree, num, "draw", stats.numSamples, &stats.draw);
+    Print("queue", tree, num, "commit", stats.numSamples, &stats.commit);
+    Print("queue", tree, num, "widgets", stats.numSamples,
+            &stats.widgets);
+
+    Find(win, tree, num);
+
+    pnWidget_destroy(win);
+    free(leaves);
+    leaves = 0;
+}
+
+
+int main(int argc, char **argv) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    const char *trees[] = { "rand", "deep", 0 };
+    uint32_t nums[] = { 1000, 10000, 100000, 0 };
+    uint32_t argNums[16] = { 0 };
+    uint32_t n = 0;
+    bool wayland = false;
+
+    for(int i = 1; i < argc; ++i) {
+        if(!strcmp(argv[i], "--wayland"))
+            wayland = true;
+        else if(!strcmp(argv[i], "rand") || !strcmp(argv[i], "deep")) {
+            trees[0] = argv[i];
+            trees[1] = 0;
+        } else if(n < 15)
+            argNums[n++] = strtoul(argv[i], 0, 10);
+    }
+
+    if(!wayland)
+        ASSERT(!pnDisplay_setHeadless(0));
+
+    uint32_t *num = n ? argNums : nums;
+
+    for(const char **tree = trees; *tree; ++tree)
+        for(uint32_t *i = num; *i; ++i)
+            Bench(*tree, *i);
+
+    return 0;
+}
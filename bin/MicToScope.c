@@ -3,6 +3,10 @@
 // So, it could be a usable program by replacing the ASSERT() calls with
 // regular error checks.  ASSERT() is just a great way to test code when
 // your not sure how things like failure modes work.
+//
+// A capture thread reads the sound into a sample ring (struct PnRing)
+// that is attached to the scope plot, so the sound reading does not wait
+// for the drawing, and the drawing does not copy the sound.
 
 /*
 
@@ -33,6 +37,8 @@ aplay -r 384000  -f S32_LE -c1 -t raw  xxx
 #include <sys/select.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "../include/panels.h"
 #include "../lib/debug.h"
@@ -68,10 +74,12 @@ static const snd_t triggerHeight = 5000000;
 
 static struct PnWidget *graph = 0;
 static int pipe_fd = -1;
+// The plotter gets at most the newest LEN samples.
 #define LEN  (1024 * 4)
-static size_t samples = 0;
-// The read(2) buffer.
-static snd_t buf[LEN];
+// The capture thread writes to the ring and the plotter reads it.
+static struct PnRing *ring = 0;
+static pthread_t thread;
+static atomic_bool stop = false;
 
 static bool triggered = false;
 
@@ -107,12 +115,8 @@ static inline void Spawn(void) {
             // I'm the parent
     }
     close(fd[1]); // close write fd.
-    int flags = fcntl(fd[0], F_GETFL, 0);
-    ASSERT(flags >= 0);
-    // We need a non-blocking read to it does not hang forever
-    // in a read(2) call.
-    ASSERT(fcntl(fd[0], F_SETFL, flags|O_NONBLOCK) != -1);
 
+    // The capture thread does blocking reads of this.
     pipe_fd = fd[0]; // pipe read fd.
 }
 
@@ -134,38 +138,66 @@ static inline void Init(void) {
 }
 
 
-static int ReadSound(int fd, void *userData) {
+// Read exactly len bytes, unless the pipe closes.
+static inline bool ReadAll(uint8_t *to, size_t len) {
 
-    DASSERT(fd >= 0);
-    DASSERT(fd == pipe_fd);
-
-    ssize_t rd;
-    size_t lenRd = 0;
-
-    // TODO: We could deal with errno. 
-    //
-    while((rd = read(pipe_fd, buf + lenRd,
-                    SAMPLE_BYTES * (LEN - lenRd))) > 0) {
-        ASSERT(rd % SAMPLE_BYTES == 0,
-                "read non-multiple of " STR(SAMPLE_BYTES) " bytes");
-        lenRd += rd;
-        if(LEN <= lenRd) break;
+    while(len) {
+        ssize_t rd = read(pipe_fd, to, len);
+        if(rd <= 0) {
+            if(rd < 0 && errno == EINTR) continue;
+            return true;
+        }
+        to += rd;
+        len -= rd;
     }
-    samples = lenRd/SAMPLE_BYTES;
-
-#if 0
-    INFO("read %zu samples:", samples);
-
-    for(size_t i=0; i < samples; ++i)
-        printf("%" SND_FMT " ", buf[i]);
-    printf("\n");
-#endif
+    return false;
+}
 
-    // If select() popped we should have data.
-    ASSERT(samples > 0);
 
-    if(samples >= pointsPerDraw)
-        pnWidget_queueDraw(graph, 0);
+// The capture thread.  It reads the sound right into the ring.
+//
+static void *ReadSound(void *data) {
+
+    size_t newSamples = 0;
+    // Where the sound goes when the ring is full.
+    static snd_t dropped[LEN];
+
+    while(!atomic_load(&stop)) {
+
+        uint32_t num;
+        snd_t *to = pnRing_writeBegin(ring, &num);
+        if(!num) {
+            // The drawing is behind.  We must keep reading the pipe, so
+            // we read and toss this sound.
+            to = dropped;
+            num = LEN;
+        }
+
+        // Read what is in the pipe now, a whole number of samples, or
+        // block for at least one sample.
+        ssize_t rd = read(pipe_fd, to, SAMPLE_BYTES * num);
+        if(rd <= 0) {
+            if(rd < 0 && errno == EINTR) continue;
+            // arecord is gone.
+            break;
+        }
+        if(rd % SAMPLE_BYTES &&
+                ReadAll(((uint8_t *) to) + rd,
+                    SAMPLE_BYTES - rd % SAMPLE_BYTES))
+            break;
+        rd = (rd + SAMPLE_BYTES - 1)/SAMPLE_BYTES;
+
+        if(to == dropped) continue;
+
+        pnRing_writeEnd(ring, rd);
+        newSamples += rd;
+
+        if(newSamples >= pointsPerDraw) {
+            // This can be called from this thread.
+            pnWidget_postDraw(graph);
+            newSamples = 0;
+        }
+    }
 
     return 0;
 }
@@ -177,55 +209,75 @@ void catcher(int sig) {
     ASSERT(0, "caught signal number %d", sig);
 }
 
-double t = 0.0;
+// The two parts of the ring samples that we got in Plot().
+static const snd_t *first, *second;
+static uint32_t numFirst, samples;
+
+static inline snd_t Sample(uint32_t i) {
+    if(i < numFirst)
+        return first[i];
+    return second[i - numFirst];
+}
 
 
 bool Plot(struct PnWidget *g, struct PnPlot *p, void *userData,
         double xMin, double xMax, double yMin, double yMax) {
 
     // Note: This trigger idea/stuff could be done in the sound read
-    // function, ReadSound(), which could make it so that the what is
+    // thread, ReadSound(), which could make it so that the what is
     // already plotted stays plotted when there is no trigger event.
 
+    // The newest LEN samples in the ring.  They are freed from the ring
+    // after we return.
+    uint32_t numSecond;
+    samples = pnPlot_getRingSamples(p, (const void **) &first, &numFirst,
+            (const void **) &second, &numSecond);
+
     // If there is no trigger than there will be nothing plotted.
-    size_t i = 1;
+    uint32_t i = 1;
     for(;!triggered && i < samples; ++i) {
 
-        if(buf[i-1] > 0 || buf[i] < triggerHeight
-                || buf[i-1] >= buf[i]) continue;
+        if(Sample(i-1) > 0 || Sample(i) < triggerHeight
+                || Sample(i-1) >= Sample(i)) continue;
 
         triggered = true;
         break;
     }
     --i;
 
-    if(!triggered || i >= samples)
+    if(!triggered || i + 1 >= samples)
         // Plot nothing in this case.
         return false;
 
     // t0 is the time that a linear interpolation shows the sound would
-    // pass through zero in both time and signal.  buf[i] is below or
-    // equal to zero and buf[i+1] is above zero.
-    ASSERT(buf[i+1] > buf[i]);
-    ASSERT(buf[i] <= 0);
+    // pass through zero in both time and signal.  Sample(i) is below or
+    // equal to zero and Sample(i+1) is above zero.
+    ASSERT(Sample(i+1) > Sample(i));
+    ASSERT(Sample(i) <= 0);
     double t0;
-    t0 = buf[i+1];
-    t0 -= buf[i];
-    ASSERT(t0 >= ((double) buf[i+1]));
-    t0 = dt - buf[i+1] * dt/(t0);
-
-    size_t num = 0;
+    t0 = Sample(i+1);
+    t0 -= Sample(i);
+    ASSERT(t0 >= ((double) Sample(i+1)));
+    t0 = dt - Sample(i+1) * dt/(t0);
 
     // Note: we are just plotting pointsPerDraw (or less) and than
-    // ignoring the rest of the sound data buffer.  We could do what ever
-    // we like.
-
-    for(;i < samples && num < pointsPerDraw; ++i, ++num) {
-        double x = num;
-        x *= dt;
-        x -= t0;
-        pnPlot_drawPoint(p, x, (double) buf[i]);
-    }
+    // ignoring the rest of the sound data.  We could do what ever we
+    // like.
+    uint32_t num = samples - i;
+    if(num > pointsPerDraw)
+        num = pointsPerDraw;
+
+    // The samples are in two parts in the ring.  The samples go straight
+    // from the ring to the plot without us making them doubles.
+    if(i < numFirst) {
+        uint32_t n = numFirst - i;
+        if(n > num) n = num;
+        pnPlot_drawSamples(p, - t0, dt, first + i, PnSampleType_int32, n);
+        pnPlot_drawSamples(p, n * dt - t0, dt, second,
+                PnSampleType_int32, num - n);
+    } else
+        pnPlot_drawSamples(p, - t0, dt, second + (i - numFirst),
+                PnSampleType_int32, num);
 
     triggered = false;
 
@@ -233,6 +285,16 @@ bool Plot(struct PnWidget *g, struct PnPlot *p, void *userData,
 }
 
 
+// Stop the capture thread before the graph is gone, so it does not post
+// draws for it.  It stops at its next read.
+//
+static void Destroy(struct PnWidget *win, void *userData) {
+
+    atomic_store(&stop, true);
+    ASSERT(pthread_join(thread, 0) == 0);
+}
+
+
 int main(void) {
 
     ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
@@ -260,12 +322,17 @@ int main(void) {
     pnPlot_setLineWidth(p, 2.2);
     pnPlot_setPointSize(p, 2.1);
 
+    // About a third of a second of sound at 192000 samples per second.
+    ring = pnRing_create(PnSampleType_int32, 1024 * 64);
+    ASSERT(ring);
+    pnPlot_setRing(p, ring, LEN);
+
     Init();
     Spawn();
+    pnWindow_setDestroy(win, Destroy, 0);
     pnWindow_show(win);
 
-    ASSERT(pnDisplay_addReader(pipe_fd, 0/*edge_trigger*/,
-            ReadSound, 0) == false);
+    ASSERT(pthread_create(&thread, 0, ReadSound, 0) == 0);
 
     if(pnDisplay_run()) {
         ERROR("pnDisplay_run() failed");
@@ -278,5 +345,6 @@ int main(void) {
         ASSERT(kill(pid, SIGTERM) == 0);
         ASSERT(waitpid(pid, 0, 0) == pid);
     }
+    pnRing_destroy(ring);
     return 0;
 }
@@ -14,6 +14,12 @@
 
 static bool ResetChildrenCull(const struct PnWidget *s);
 
+// Set if ResetChildrenCull() found a splitter container; splitters
+// change their children's sizes while we get the allocations, so we can't
+// keep the natural sizes from windows with them.  This code is not
+// called from more than one thread.
+static bool sawSplitter;
+
 
 // Return true if at least one child is not culled.
 //
@@ -34,6 +40,7 @@ static inline bool GridResetChildrenCull(const struct PnWidget *s) {
             struct PnWidget *c = child[y][x];
             if(!c) continue;
             c->culled = ResetChildrenCull(c);
+            c->naturalCulled = c->culled;
 
             if(!c->culled && culled)
                 // We have at least one child not culled and the
@@ -54,6 +61,7 @@ bool pnList_ResetChildrenCull(const struct PnWidget *s) {
     for(struct PnWidget *c = s->l.firstChild; c;
             c = c->pl.nextSibling) {
         c->culled = ResetChildrenCull(c);
+        c->naturalCulled = c->culled;
 
         if(!c->culled && culled)
             // We have at least one child not culled and the
@@ -103,7 +111,8 @@ static bool ResetChildrenCull(const struct PnWidget *s) {
     // controlled by the splitter container widget to be squished to the
     // side.
     //
-    if(s->parent && IS_TYPE1(s->parent->type, PnWidgetType_splitter))
+    if(s->parent && IS_TYPE1(s->parent->type, PnWidgetType_splitter)) {
+        sawSplitter = true;
         if( (s->parent->l.firstChild && s->parent->l.firstChild == s
                 && ((struct PnSplitter *)s->parent)->firstHidden)
                     ||
@@ -112,6 +121,7 @@ static bool ResetChildrenCull(const struct PnWidget *s) {
             // This widget, "s", will be forced to be culled by the
             // splitter container widget user interaction.
             culled = true;
+    }
 
 
     if(culled || !HaveChildren(s))
@@ -170,6 +180,7 @@ static uint32_t ResetCanExpand(struct PnWidget *s) {
         // This is a leaf node.  We are at an end of the function call
         // stack.  s->expand is a user set attribute.
         s->canExpand = s->expand;
+        s->naturalExpand = s->canExpand;
         return s->canExpand;
     }
 
@@ -188,6 +199,7 @@ static uint32_t ResetCanExpand(struct PnWidget *s) {
                 s->canExpand |= ResetCanExpand(c);
             }
         }
+        s->naturalExpand = s->canExpand;
         return s->canExpand;
     }
 
@@ -203,6 +215,7 @@ static uint32_t ResetCanExpand(struct PnWidget *s) {
         s->canExpand |= ResetCanExpand(c);
     }
 
+    s->naturalExpand = s->canExpand;
     // Return if we have any leaf children that can expand.
     return s->canExpand;
 }
@@ -284,7 +297,7 @@ static inline uint32_t GetBHeight(const struct PnWidget *s) {
 // This does not get the positions of the widgets.  We must get that
 // after we have the sizes.
 //
-static void TallyRequestedSizes(const struct PnWidget *s,
+static void TallyRequestedSizes(struct PnWidget *s,
         struct PnAllocation *a) {
 
     DASSERT(s);
@@ -443,6 +456,10 @@ static void TallyRequestedSizes(const struct PnWidget *s,
     // Add the last border or first size if there are no children.
     a->width += borderX;
     a->height += borderY;
+
+    // If nothing gets clipped or culled this is the natural size.
+    s->naturalWidth = a->width;
+    s->naturalHeight = a->height;
 }
 
 // At this point we have the widths and heights of all widgets
@@ -2150,6 +2167,9 @@ void _pnWidget_getAllocations(struct PnWidget *s) {
     struct PnAllocation *a = &s->allocation;
     DASSERT(!s->culled);
 
+    // The widget positions are changing.
+    InvalidateFindIndex(s->window);
+
     if(!a->width && !HaveChildren(s)) {
         DASSERT(!a->height);
         DASSERT((s->type & TOPLEVEL) ||
@@ -2201,6 +2221,16 @@ void _pnWidget_getAllocations(struct PnWidget *s) {
     // We count widget tree passes, but note: widget passes can get
     // quicker as widget passes cull out widgets.
 
+    // To see if the natural size of "s" changed.
+    uint32_t naturalWidth = s->naturalWidth;
+    uint32_t naturalHeight = s->naturalHeight;
+    enum PnExpand naturalExpand = s->naturalExpand;
+    // Set if "s" is smaller than its natural size, so something in it is
+    // clipped or culled.
+    bool squeezed = false;
+
+    sawSplitter = false;
+
     ResetChildrenCull(s); // PASS 1
 
     uint32_t loopCount = 0;
@@ -2281,6 +2311,7 @@ void _pnWidget_getAllocations(struct PnWidget *s) {
             DASSERT(height);
             a->width = width;
             a->height = height;
+            squeezed = true;
         } else {
             // This is the first call to _pnWidget_getAllocations() for
             // this window and a->width and a->height where both zero at
@@ -2366,5 +2397,162 @@ void _pnWidget_getAllocations(struct PnWidget *s) {
     // the user clicks a widget that closes it.
     ResetDisplaySurfaces();
 
+    // If "s" was never smaller than its natural size nothing was clipped
+    // or culled for lack of space, so the natural sizes we just got are
+    // good.  Counting the tallies is not enough: leaf widgets can be
+    // clipped without another tally.
+    struct PnWindow *win = s->window;
+    DASSERT(win);
+    if(s == &win->widget)
+        win->naturalValid = (!squeezed && !sawSplitter);
+    else if(squeezed || sawSplitter ||
+            naturalWidth != s->naturalWidth ||
+            naturalHeight != s->naturalHeight ||
+            naturalExpand != s->naturalExpand)
+        // The natural sizes of the widgets above "s" may be wrong now.
+        win->naturalValid = false;
+
     //INFO("w,h=%" PRIi32",%" PRIi32, a->width, a->height);
 }
+
+
+// Get the natural (shrink wrapped) size, culling, and expandability of
+// "s" from the natural sizes of its children, like ResetChildrenCull(),
+// TallyRequestedSizes(), and ResetCanExpand() do when nothing is clipped
+// or culled for lack of space.  If "deep" is set we get them for all the
+// descendants of "s" too, else we use the ones the children have.
+//
+// Returns true if we can't; we do not do grid and splitter containers
+// this way.
+//
+static bool GetNaturalSize(struct PnWidget *s, bool deep) {
+
+    DASSERT(s);
+
+    if(s->layout == PnLayout_Grid ||
+            IS_TYPE1(s->type, PnWidgetType_splitter))
+        return true;
+
+    s->naturalCulled = s->hidden;
+    s->naturalExpand = s->expand;
+    s->naturalWidth = 0;
+    s->naturalHeight = 0;
+
+    if(s->hidden)
+        // The children of a hidden widget are not looked at until it is
+        // shown.
+        return false;
+
+    uint32_t borderX = GetBWidth(s);
+    uint32_t borderY = GetBHeight(s);
+    uint32_t width = 0, height = 0;
+    bool gotOne = false;
+
+    if(HaveChildren(s)) {
+
+        if(s->layout == PnLayout_None)
+            return true;
+
+        for(struct PnWidget *c = s->l.firstChild; c;
+                c = c->pl.nextSibling) {
+            if(deep && GetNaturalSize(c, true))
+                return true;
+            if(c->naturalCulled) continue;
+            gotOne = true;
+            s->naturalExpand |= c->naturalExpand;
+            switch(s->layout) {
+                case PnLayout_BT:
+                case PnLayout_TB:
+                    height += c->naturalHeight + borderY;
+                    if(width < c->naturalWidth)
+                        width = c->naturalWidth;
+                    break;
+                default:
+                    width += c->naturalWidth + borderX;
+                    if(height < c->naturalHeight)
+                        height = c->naturalHeight;
+            }
+        }
+
+        if(!gotOne) {
+            // All the children are culled, so "s" is too.
+            s->naturalCulled = true;
+            s->naturalExpand = s->expand;
+            return false;
+        }
+
+        if(s->layout == PnLayout_BT || s->layout == PnLayout_TB)
+            width += borderX;
+        else
+            height += borderY;
+    }
+
+    s->naturalWidth = width + borderX;
+    s->naturalHeight = height + borderY;
+    return false;
+}
+
+
+// Called from pnWidget_show() after s->hidden is changed, and from
+// pnWidget_setSize() after the requested size of "s" is changed.
+//
+// Showing, hiding, or resizing a widget changes the natural size of its
+// parent, and maybe the parent's parent and so on up.  We go up the widget tree
+// until we get to a widget whose natural size does not change.  That
+// widget keeps its allocation and we just redo the allocations of its
+// children, and not of all the widgets in the window.  We only know that
+// is the same as redoing all the allocations if no widgets were clipped
+// or culled for lack of space in the window.
+//
+// Returns true if all the allocations in the window need to be redone.
+//
+bool RelayoutChanged(struct PnWidget *s) {
+
+    DASSERT(s);
+    DASSERT(s->parent);
+    struct PnWindow *win = s->window;
+    DASSERT(win);
+
+    if(!win->naturalValid || win->widget.needAllocate)
+        return true;
+
+    if(GetNaturalSize(s, true))
+        return true;
+
+    struct PnWidget *p = s->parent;
+
+    for(; p != &win->widget; p = p->parent) {
+
+        DASSERT(p);
+
+        if(p->hidden)
+            // Nothing that is showing changes.
+            return false;
+
+        uint32_t width = p->naturalWidth;
+        uint32_t height = p->naturalHeight;
+        enum PnExpand expand = p->naturalExpand;
+        bool culled = p->naturalCulled;
+
+        if(GetNaturalSize(p, false))
+            return true;
+
+        if(culled != p->naturalCulled)
+            // Showing or not showing changed.
+            continue;
+        if(culled)
+            // Still not showing.
+            return false;
+        if(width == p->naturalWidth && height == p->naturalHeight &&
+                expand == p->naturalExpand)
+            break;
+    }
+
+    if(p == &win->widget)
+        // The natural size of the window changed, so we redo all of it.
+        return true;
+
+    DASSERT(!p->culled);
+    QueueAllocateChildren(p);
+    return false;
+}
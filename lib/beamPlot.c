@@ -58,8 +58,8 @@ struct PnPlot *pnScopePlot_createWithBeam(struct PnWidget *graph,
 
 // Free memory when the graph widget is destroyed.
 //
-// The beam plot need an extra memory allocation to store the beam point
-// list in.  We clean it up with the graph.
+// The beam plot needs extra memory allocations to store the beam point
+// ring and the graph beam pixels in.  We clean them up with the graph.
 //
 // TODO: Do we want a way to destroy a beam scope plot thingy without
 // destroying the graph?  Maybe not.  Looks like panel widget actions
@@ -75,24 +75,64 @@ void destroy_beam(struct PnWidget *w, struct PnPlot *p) {
     struct PnBeam *b = p->beam;
     DASSERT(b);
 
-    if(g->beamPoints) {
+    if(g->beamPixels) {
         // Cleanup at most one per graph.
-        DASSERT(g->beamPoints_width);
-        DASSERT(g->beamPoints_height);
-        DZMEM(g->beamPoints,
-                g->beamPoints_width * g->beamPoints_height *
-                sizeof(*g->beamPoints));
-        g->beamPoints = 0;
-        g->beamPoints_width = 0;
-        g->beamPoints_height = 0;
+        DASSERT(g->beamPixels_width);
+        DASSERT(g->beamPixels_height);
+        DZMEM(g->beamPixels,
+                g->beamPixels_width * g->beamPixels_height *
+                sizeof(*g->beamPixels));
+        free(g->beamPixels);
+        g->beamPixels = 0;
+        g->beamPixels_width = 0;
+        g->beamPixels_height = 0;
     }
 
+    if(b->points) {
+        DZMEM(b->points, b->maxPoints * sizeof(*b->points));
+        free(b->points);
+    }
+    if(b->fadeWeights) {
+        DZMEM(b->fadeWeights, b->fadePoints * sizeof(*b->fadeWeights));
+        free(b->fadeWeights);
+    }
     DZMEM(b, sizeof(*b));
     free(b);
     p->beam = 0;
 }
 
 
+// The number of beam pixels that we look at for stale stamps in each
+// draw frame after a beam reset.
+#define SWEEP_PIXELS  (64 * 1024)
+
+// Clear some of the stale stamps in the graph beam pixels; all of them if
+// the stamps are getting close to wrapping around to the stale ones.
+//
+static inline void SweepBeamPixels(struct PnGraph *g) {
+
+    DASSERT(g->beamSweeping);
+    DASSERT(g->beamPixels);
+
+    uint32_t num = g->beamPixels_width * g->beamPixels_height;
+    uint32_t end = num;
+    if(g->beamStamp - g->beamResetStamp < (((uint32_t) 1) << 30) &&
+            num - g->beamSweep > SWEEP_PIXELS)
+        end = g->beamSweep + SWEEP_PIXELS;
+
+    struct PnBeamPixel *bp = g->beamPixels + g->beamSweep;
+    struct PnBeamPixel *last = g->beamPixels + end;
+    for(; bp < last; ++bp)
+        if(!BeamStampValid(g, bp->stamp))
+            bp->stamp = 0;
+
+    g->beamSweep = end;
+    if(end == num)
+        // There are no stale stamps now.
+        g->beamSweeping = false;
+}
+
+
 // Add a scope plot with fading beam that does not use Cairo to draw.
 // Cairo is still used to draw the grid background for the graph widget.
 //
@@ -128,6 +168,29 @@ void AddScopeBeamPlot(struct PnWidget *w, struct PnCallback *callback,
     beam->maxPoints = par->maxPoints;
     beam->fadePoints = par->fadePoints;
 
+    if(beam->maxPoints) {
+        beam->points = calloc(beam->maxPoints, sizeof(*beam->points));
+        ASSERT(beam->points, "calloc(%" PRIi32 ",%zu) failed",
+                beam->maxPoints, sizeof(*beam->points));
+
+        // The fade ramp.  The point that is "age" draws old is
+        // (age - fade_age)/fade_age of the way from the point color to
+        // the original pixel color.  When the whole beam fades, fade_age
+        // is 0, we spread the fade over all of it.
+        beam->fadeWeights = calloc(beam->fadePoints,
+                sizeof(*beam->fadeWeights));
+        ASSERT(beam->fadeWeights, "calloc(%" PRIi32 ",%zu) failed",
+                beam->fadePoints, sizeof(*beam->fadeWeights));
+        int32_t fade_age = beam->maxPoints - beam->fadePoints;
+        double span = fade_age ? fade_age : beam->fadePoints;
+        for(int32_t k = 0; k < beam->fadePoints; ++k) {
+            double fade = k/span;
+            if(fade > 1.0)
+                fade = 1.0;
+            beam->fadeWeights[k] = (uint16_t) (256.0 * fade + 0.5);
+        }
+    }
+
     // TODO: removing scopes?
     if(!p->graph->have_scopes)
         p->graph->have_scopes = true;
@@ -178,35 +241,50 @@ bool ScopeBeamDrawAction(struct PnGraph *g, struct PnCallback *callback,
     p->shiftX = g->padX - g->slideX;
     p->shiftY = g->padY - g->slideY;
 
-    if(!g->beamPoints ||
-            g->beamPoints_width != width ||
-            g->beamPoints_height != height) {
+    // The beam point x and y are stored in 16 bits each.
+    ASSERT(width <= 0xFFFF && height <= 0xFFFF);
 
-        // All the fading beam plots share the same beamPoints array
+    if(!g->beamPixels ||
+            g->beamPixels_width != width ||
+            g->beamPixels_height != height) {
+
+        // All the fading beam plots share the same beamPixels array
         // that is for the whole graph.  One could have more than one
         // fading beam plot in a graph.
         //
-        // TODO: Note this is quite a bit of memory being allocated.
-        //
-        size_t size = width * height * sizeof(*g->beamPoints);
-        g->beamPoints = realloc(g->beamPoints, size);
-        ASSERT(g->beamPoints, "realloc(,%zu) failed", size);
-        g->beamPoints_width = width;
-        g->beamPoints_height = height;
-        memset(g->beamPoints, 0, size);
-        beam->first = 0;
-        beam->last = 0;
+        size_t size = width * height * sizeof(*g->beamPixels);
+        g->beamPixels = realloc(g->beamPixels, size);
+        ASSERT(g->beamPixels, "realloc(,%zu) failed", size);
+        g->beamPixels_width = width;
+        g->beamPixels_height = height;
+        memset(g->beamPixels, 0, size);
+        g->beamReset = false;
+        g->beamSweeping = false;
     } else if(g->beamReset) {
-        size_t size = width * height * sizeof(*g->beamPoints);
-        memset(g->beamPoints, 0, size);
-        beam->first = 0;
-        beam->last = 0;
+        // The graph background was drawn over all the beams.  The points
+        // in the beam rings do not own the pixels any more, so they are
+        // just skipped.  We do this once for all the beams in the graph.
+        //
+        // We used to memset() all of beamPixels here, which is a lot of
+        // memory to write at every frame of a graph drag or zoom.  Now
+        // it's just marking all the stamps we made so far as stale.
+        g->beamResetStamp = g->beamStamp;
+        g->beamSweep = 0;
+        g->beamSweeping = true;
+        g->beamReset = false;
     }
 
+    if(g->beamSweeping)
+        SweepBeamPixels(g);
+
     // userCallback() may call the pnGraph_drawPoint() function many
     // times.
+    PlotRingBegin(p);
     bool ret = userCallback(&g->widget, p, userData,
             g->xMin, g->xMax, g->yMin, g->yMax);
+    PlotRingEnd(p);
+
+    FadeBeam(p);
 
     // g->pushBGSurface = true;
 
@@ -25,7 +25,8 @@ static bool ResizeBuffer(struct PnWindow *win, struct PnBuffer *buffer,
     DASSERT(buffer->size);
     DASSERT(buffer->fd > -1);
     DASSERT(buffer->size < size);
-    DASSERT(buffer->width * buffer->height * PN_PIXEL_SIZE == size);
+    DASSERT(buffer->width * buffer->height *
+            PixelSize(buffer->format) == size);
 
     if(buffer->pixels != MAP_FAILED) {
         if(munmap(buffer->pixels, buffer->size))
@@ -39,8 +40,7 @@ static bool ResizeBuffer(struct PnWindow *win, struct PnBuffer *buffer,
     }
     buffer->size = size;
 
-    buffer->pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
-		buffer->fd, 0);
+    buffer->pixels = map_shm_file(buffer->fd, size);
     if(buffer->pixels == MAP_FAILED) {
         ERROR("mmap() failed");
         goto fail;
@@ -66,19 +66,24 @@ static bool ResizeBuffer(struct PnWindow *win, struct PnBuffer *buffer,
     // keep the two buffers correct without a lot of memory copying,
     // making it much more OS (operating system) resource intensive than
     // using one buffer.
+    //
+    // Now there's an optional swapchain that keeps drawing to this one
+    // buffer and copies just the changed parts to the other wl_buffers.
+    // See struct PnSwapBuffer in display.h.
 
     buffer->wl_buffer = wl_shm_pool_create_buffer(
             buffer->wl_shm_pool, 0,
 	    buffer->width, buffer->height,
-            buffer->width * PN_PIXEL_SIZE/*stride in bytes*/,
-            WL_SHM_FORMAT_ARGB8888);
+            buffer->width * PixelSize(buffer->format)/*stride in bytes*/,
+            buffer->format);
     if(!buffer->wl_buffer) {
         ERROR("wl_shm_pool_create_buffer() failed");
         goto fail;
     }
 
 #ifdef WITH_CAIRO
-    RecreateCairos(win, 0);
+    if(win)
+        RecreateCairos(win, 0);
 #endif
 
     return false;
@@ -90,6 +95,8 @@ fail:
     return true;
 }
 
+// The buffer->format must be set before calling this.
+//
 // Return false on success.
 //
 static bool CreateBuffer(struct PnWindow *win, struct PnBuffer *buffer,
@@ -102,8 +109,7 @@ static bool CreateBuffer(struct PnWindow *win, struct PnBuffer *buffer,
     if(buffer->fd <= -1)
         goto fail;
 
-    buffer->pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
-            buffer->fd, 0);
+    buffer->pixels = map_shm_file(buffer->fd, size);
     if(buffer->pixels == MAP_FAILED) {
         ERROR("mmap() failed");
         goto fail;
@@ -120,15 +126,144 @@ static bool CreateBuffer(struct PnWindow *win, struct PnBuffer *buffer,
     }
     buffer->wl_buffer = wl_shm_pool_create_buffer(buffer->wl_shm_pool, 0,
 			buffer->width, buffer->height,
-                        buffer->width*PN_PIXEL_SIZE /*stride in bytes*/,
-                        WL_SHM_FORMAT_ARGB8888);
+                        buffer->width*PixelSize(buffer->format)
+                        /*stride in bytes*/,
+                        buffer->format);
     if(!buffer->wl_buffer) {
         ERROR("wl_shm_pool_create_buffer() failed");
         goto fail;
     }
 #ifdef WITH_CAIRO
-    RecreateCairos(win, 0);
+    if(win)
+        // win is 0 for swapchain buffers, which have no Cairo surfaces
+        // on them.
+        RecreateCairos(win, 0);
+#endif
+    return false;
+
+fail:
+
+    FreeBuffer(buffer);
+
+    return true;
+}
+
+// Buffer pool mode (see pnWindow_setBufferPool()):
+//
+// The shared memory file, its mapping, and the wl_shm_pool are made
+// POOL_GROW times larger than needed, and the wl_buffer is carved out of
+// the start of it with the current width and height.  So as the window
+// is resized, like when the user drags the window edge, we just remake
+// the wl_buffer until the window outgrows the pool, or until the pool is
+// more than POOL_SHRINK times larger than it needs to be.
+//
+#define POOL_GROW(size)    ((size) + (size)/2) // 1.5 times
+#define POOL_SHRINK        (4)
+
+// Make a new mapping of "size" bytes and a new wl_shm_pool for it.
+//
+// Return false on success.
+//
+static bool MapPool(struct PnBuffer *buffer, size_t size) {
+
+    DASSERT(buffer);
+    DASSERT(size);
+
+    if(buffer->pixels != MAP_FAILED) {
+        if(munmap(buffer->pixels, buffer->size))
+            ASSERT(0, "munmap() failed");
+        buffer->pixels = MAP_FAILED;
+    }
+
+    if(buffer->fd > -1 && size < buffer->size) {
+        // We do not shrink the file.  The compositor may still have the
+        // old file mapped, and reading past the end of a truncated file
+        // is a SIGBUS.  We just make a new file.
+        close(buffer->fd);
+        buffer->fd = -1;
+    }
+
+    if(buffer->fd <= -1) {
+        buffer->fd = create_shm_file(size);
+        if(buffer->fd <= -1)
+            return true;
+    } else if(ftruncate(buffer->fd, size) == -1) {
+        ERROR("ftruncate(%d,%zu) failed", buffer->fd, size);
+        return true;
+    }
+    buffer->size = size;
+
+    buffer->pixels = map_shm_file(buffer->fd, size);
+    if(buffer->pixels == MAP_FAILED) {
+        ERROR("mmap() failed");
+        return true;
+    }
+
+    if(buffer->wl_shm_pool)
+        wl_shm_pool_destroy(buffer->wl_shm_pool);
+
+    buffer->wl_shm_pool = wl_shm_create_pool(d.wl_shm, buffer->fd, size);
+    if(!buffer->wl_shm_pool) {
+        ERROR("wl_shm_create_pool() failed");
+        return true;
+    }
+    return false;
+}
+
+// Make the buffer width x height with the wl_shm format using buffer
+// pool mode.  Pass in win to remake the Cairo surfaces of the window's
+// widgets, or 0 for a swapchain buffer.
+//
+// Return false on success.
+//
+static bool PoolBuffer(struct PnWindow *win, struct PnBuffer *buffer,
+        uint32_t width, uint32_t height, uint32_t format) {
+
+    DASSERT(buffer);
+    DASSERT(width);
+    DASSERT(height);
+
+    size_t need = width * height * PixelSize(format);
+    bool remapped = false;
+
+    if(!buffer->wl_shm_pool || buffer->size < need ||
+            buffer->size > POOL_SHRINK * need) {
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t size = POOL_GROW(need);
+        size = ((size + page - 1)/page) * page;
+        if(MapPool(buffer, size))
+            goto fail;
+        remapped = true;
+    }
+
+    if(!remapped && buffer->wl_buffer &&
+            buffer->width == width && buffer->height == height &&
+            buffer->format == format)
+        // Nothing to do.
+        return false;
+
+    if(buffer->wl_buffer)
+        wl_buffer_destroy(buffer->wl_buffer);
+
+    buffer->width = width;
+    buffer->height = height;
+    buffer->stride = width; // in pixels
+    buffer->format = format;
+
+    buffer->wl_buffer = wl_shm_pool_create_buffer(buffer->wl_shm_pool, 0,
+            width, height, width * PixelSize(format)/*stride in bytes*/,
+            format);
+    if(!buffer->wl_buffer) {
+        ERROR("wl_shm_pool_create_buffer() failed");
+        goto fail;
+    }
+
+#ifdef WITH_CAIRO
+    if(win)
+        // The stride may have changed, even if the pixels did not move.
+        RecreateCairos(win, 0);
 #endif
+
     return false;
 
 fail:
@@ -138,30 +273,373 @@ fail:
     return true;
 }
 
+// The wl_shm format of the buffer that the widgets draw to.
+//
+static inline uint32_t GetDrawFormat(const struct PnWindow *win) {
+
+    switch(win->pixelFormat) {
+        case PnPixelFormat_ARGB8888:
+            return WL_SHM_FORMAT_ARGB8888;
+        case PnPixelFormat_XRGB8888:
+        case PnPixelFormat_RGB565: // It has no alpha either.
+            return WL_SHM_FORMAT_XRGB8888;
+        case PnPixelFormat_auto:
+        default:
+            // If the window and widget backgrounds are opaque we assume
+            // that the window is opaque, so the compositor need not
+            // blend it with what's under it.  See CheckOpaque().
+            if(win->opaque)
+                return WL_SHM_FORMAT_XRGB8888;
+            return WL_SHM_FORMAT_ARGB8888;
+    }
+}
+
+// Are the background colors of "w" and all the widgets in it opaque?
+// Hidden widgets count too, since they can be shown without a recheck.
+//
+static bool Opaque(struct PnWidget *w) {
+
+    DASSERT(w);
+
+    if((w->backgroundColor & 0xFF000000) != 0xFF000000)
+        return false;
+
+    if(w->layout == PnLayout_Grid) {
+        if(!w->g.grid) return true;
+        struct PnWidget ***child = w->g.grid->child;
+        if(!child) return true;
+        for(uint32_t y=w->g.numRows-1; y != -1; --y)
+            for(uint32_t x=w->g.numColumns-1; x != -1; --x) {
+                struct PnWidget *c = child[y][x];
+                if(c && IsUpperLeftCell(c, child, x, y) && !Opaque(c))
+                    return false;
+            }
+        return true;
+    }
+
+    for(struct PnWidget *c = w->l.firstChild; c; c = c->pl.nextSibling)
+        if(!Opaque(c))
+            return false;
+    return true;
+}
+
+// Called when PnWindow::checkOpaque is set, after a background color
+// changed or a widget was added.  A widget that draws its translucent
+// background color straight into the pixels leaves the alpha in them, so
+// then the window can't be XRGB8888.  Drawing (like with Cairo) over an
+// opaque background stays opaque.
+//
+// Returns true if the window has a buffer and its draw format changes,
+// so all of the window needs drawing in a new buffer.
+//
+bool CheckOpaque(struct PnWindow *win) {
+
+    DASSERT(win);
+    DASSERT(win->checkOpaque);
+
+    uint32_t format = GetDrawFormat(win);
+    win->opaque = Opaque(&win->widget);
+    win->checkOpaque = false;
+
+    return (HaveBuffer(&win->buffer) && format != GetDrawFormat(win));
+}
+
+// The wl_shm format of the swapchain buffers.
+//
+static inline uint32_t GetSwapFormat(const struct PnWindow *win) {
+
+    if(win->pixelFormat == PnPixelFormat_RGB565 &&
+            HaveShmFormat(WL_SHM_FORMAT_RGB565))
+        return WL_SHM_FORMAT_RGB565;
+    return GetDrawFormat(win);
+}
+
+static void SwapBufferRelease(struct PnSwapBuffer *sb,
+        struct wl_buffer *wl_buffer) {
+
+    DASSERT(sb);
+    DASSERT(sb->busy);
+    DASSERT(sb->buffer.wl_buffer == wl_buffer);
+    struct PnWindow *win = sb->window;
+    DASSERT(win);
+
+    sb->busy = false;
+
+    if(!win->waitingForRelease) return;
+
+    // We skipped drawing because all the swapchain buffers were busy.
+    // Now that we have one we ask for a frame callback so that the
+    // drawing gets done in frame_new() in window.c.
+    win->waitingForRelease = false;
+    if(win->needDraw || win->dqWrite->first)
+        _pnWindow_addCallback(win);
+}
+
+static const struct wl_buffer_listener swapBuffer_listener = {
+    .release = (void (*)(void *, struct wl_buffer *)) SwapBufferRelease
+};
+
+// Add the region to the regions that need to be copied to this swapchain
+// buffer before it's shown next.
+//
+static inline void AddSwapDamage(struct PnSwapBuffer *sb,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+
+    if(sb->numDamage < PN_MAX_SWAP_DAMAGE) {
+        struct PnAllocation *a = sb->damage + sb->numDamage++;
+        a->x = x;
+        a->y = y;
+        a->width = width;
+        a->height = height;
+        return;
+    }
+
+    // We ran out of rectangles.  Make the first one the bounding box of
+    // them all plus this new one.  Copying a few too many pixels is
+    // better than keeping a long list.
+    struct PnAllocation *a = sb->damage;
+    uint32_t x1 = a->x + a->width, y1 = a->y + a->height;
+    if(x < a->x) a->x = x;
+    if(y < a->y) a->y = y;
+    if(x + width > x1) x1 = x + width;
+    if(y + height > y1) y1 = y + height;
+    for(uint32_t i = 1; i < sb->numDamage; ++i) {
+        struct PnAllocation *b = sb->damage + i;
+        if(b->x < a->x) a->x = b->x;
+        if(b->y < a->y) a->y = b->y;
+        if(b->x + b->width > x1) x1 = b->x + b->width;
+        if(b->y + b->height > y1) y1 = b->y + b->height;
+    }
+    a->width = x1 - a->x;
+    a->height = y1 - a->y;
+    sb->numDamage = 1;
+}
+
+// Copy the 4 byte ARGB pixels in the rectangle x,y to x1,y1 into 16 bit
+// RGB565 pixels.
+//
+static inline void CopyRectTo565(struct PnBuffer *to,
+        const struct PnBuffer *from,
+        uint32_t x, uint32_t y, uint32_t x1, uint32_t y1) {
+
+    uint16_t *t = ((uint16_t *) to->pixels) + y * to->stride + x;
+    const uint32_t *f = from->pixels + y * from->stride + x;
+    uint32_t w = x1 - x;
+
+    for(; y < y1; ++y) {
+        for(uint32_t i = 0; i < w; ++i) {
+            uint32_t c = f[i];
+            t[i] = ((c >> 8) & 0xF800) | // red   5 bits
+                   ((c >> 5) & 0x07E0) | // green 6 bits
+                   ((c >> 3) & 0x001F);  // blue  5 bits
+        }
+        t += to->stride;
+        f += from->stride;
+    }
+}
+
+// Copy the pixels in the rectangle "a" from buffer "from" to buffer
+// "to".  The two buffers must be the same size.  "from" is the 4 byte per
+// pixel drawing buffer.
+//
+static inline void CopyRect(struct PnBuffer *to,
+        const struct PnBuffer *from, const struct PnAllocation *a) {
+
+    DASSERT(to->width == from->width);
+    DASSERT(to->height == from->height);
+    DASSERT(to->stride == from->stride);
+    DASSERT(PixelSize(from->format) == 4);
+
+    uint32_t x1 = a->x + a->width, y1 = a->y + a->height;
+    if(x1 > to->width) x1 = to->width;
+    if(y1 > to->height) y1 = to->height;
+    if(a->x >= x1 || a->y >= y1) return;
+
+    if(to->format == WL_SHM_FORMAT_RGB565) {
+        CopyRectTo565(to, from, a->x, a->y, x1, y1);
+        return;
+    }
+
+    // ARGB8888 and XRGB8888 have the same bits.
+    uint32_t *t = to->pixels + a->y * to->stride + a->x;
+    const uint32_t *f = from->pixels + a->y * from->stride + a->x;
+
+    if(a->x == 0 && x1 == to->stride) {
+        // Whole rows; one memcpy() for all of it.
+        memcpy(t, f, (y1 - a->y) * to->stride * 4);
+        return;
+    }
+
+    size_t n = (x1 - a->x) * 4;
+    for(uint32_t y = a->y; y < y1; ++y) {
+        memcpy(t, f, n);
+        t += to->stride;
+        f += from->stride;
+    }
+}
+
+// Find a swapchain buffer that is not busy and make sure that it is the
+// correct size.  Returns 0 if they are all busy or on failure.
+//
+static struct PnSwapBuffer *GetSwapBuffer(struct PnWindow *win) {
+
+    DASSERT(win);
+    DASSERT(win->numSwapBuffers);
+    DASSERT(win->numSwapBuffers <= PN_MAX_SWAP_BUFFERS);
+
+    const struct PnBuffer *draw = &win->buffer;
+    struct PnSwapBuffer *sb = 0;
+    uint32_t format = GetSwapFormat(win);
+
+    // Prefer a free buffer that is already the correct size, so that we
+    // do not make new shared memory when we do not need to.
+    for(uint32_t i = 0; i < win->numSwapBuffers; ++i) {
+        struct PnSwapBuffer *b = win->swapBuffers + i;
+        if(b->busy) continue;
+        if(!sb) sb = b;
+        if(b->buffer.wl_buffer && b->buffer.width == draw->width &&
+                b->buffer.height == draw->height &&
+                b->buffer.format == format) {
+            sb = b;
+            break;
+        }
+    }
+
+    if(!sb) return 0; // They are all busy.
+
+    if(sb->buffer.wl_buffer && sb->buffer.width == draw->width &&
+            sb->buffer.height == draw->height &&
+            sb->buffer.format == format)
+        return sb;
+
+    // Remake this buffer with the new size and/or format.
+    sb->window = win;
+    if(win->bufferPool) {
+        if(PoolBuffer(0, &sb->buffer, draw->width, draw->height, format))
+            return 0;
+    } else {
+        FreeBuffer(&sb->buffer);
+        sb->buffer.width = draw->width;
+        sb->buffer.height = draw->height;
+        sb->buffer.stride = draw->stride;
+        sb->buffer.format = format;
+        if(CreateBuffer(0, &sb->buffer, draw->width * draw->height *
+                    PixelSize(format)))
+            return 0;
+    }
+    if(wl_buffer_add_listener(sb->buffer.wl_buffer,
+                &swapBuffer_listener, sb)) {
+        ERROR("wl_buffer_add_listener() failed");
+        FreeBuffer(&sb->buffer);
+        return 0;
+    }
+    // All of it is stale.
+    sb->numDamage = 0;
+    AddSwapDamage(sb, 0, 0, draw->width, draw->height);
+
+    return sb;
+}
+
+// In headless mode, and in swapchain mode, the buffer that the widgets
+// draw to is just anonymous memory from mmap(2), so FreeBuffer() can free
+// it like any other buffer.  The compositor never reads it, so it has no
+// shared memory file, no wl_shm_pool, and no wl_buffer.  In swapchain
+// mode the swapchain buffers have them.
+//
+// Return false on success.
+//
+static bool MemoryBuffer(struct PnWindow *win, struct PnBuffer *buffer,
+        uint32_t width, uint32_t height, uint32_t format) {
+
+    DASSERT(d.headless || win->numSwapBuffers);
+
+    if(buffer->pixels != MAP_FAILED && !buffer->wl_buffer &&
+            buffer->width == width && buffer->height == height &&
+            buffer->format == format)
+        return false;
+
+    FreeBuffer(buffer);
+
+    size_t size = width * height * PN_PIXEL_SIZE;
+    buffer->pixels = mmap(0, size, PROT_READ|PROT_WRITE,
+            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(buffer->pixels == MAP_FAILED) {
+        ERROR("mmap(0,%zu,,,-1,0) failed", size);
+        FreeBuffer(buffer);
+        return true;
+    }
+    buffer->size = size;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->stride = width; // in 4 byte chunks (uint32_t)
+    buffer->format = format;
+
+#ifdef WITH_CAIRO
+    RecreateCairos(win, 0);
+#endif
+    return false;
+}
+
 // Returns the buffer (pixels) that we can draw to
 // with the corrected sizes.
 //
+// In swapchain mode this returns 0 if all the swapchain buffers are busy,
+// and sets win->waitingForRelease.
+//
 struct PnBuffer *GetNextBuffer(struct PnWindow *win,
         uint32_t width, uint32_t height) {
 
     DASSERT(win);
-    DASSERT(d.wl_display);
-    DASSERT(win->wl_surface);
-    DASSERT(win->xdg_surface);
+    DASSERT(HaveSurface(win));
     DASSERT(width > 0);
     DASSERT(height > 0);
 
     struct PnBuffer *buffer = &win->buffer;
 
+    // The buffer that the widgets draw to always has 4 byte pixels.
     DASSERT(PN_PIXEL_SIZE == 4);
     size_t size = width * height * PN_PIXEL_SIZE;
+    if(win->checkOpaque)
+        CheckOpaque(win);
+    uint32_t format = GetDrawFormat(win);
 
-    if(buffer->wl_buffer && buffer->size > size) {
+    if(d.headless) {
+        if(MemoryBuffer(win, buffer, width, height, format))
+            return 0;
+        return buffer;
+    }
+
+    DASSERT(d.wl_display);
+    DASSERT(win->wl_surface);
+    DASSERT(win->xdg_surface);
+
+    if(win->numSwapBuffers) {
+        // Only the swapchain buffers are shared with the compositor.
+        if(MemoryBuffer(win, buffer, width, height, format))
+            return 0;
+        goto haveBuffer;
+    }
+
+    if(!buffer->wl_buffer && buffer->pixels != MAP_FAILED)
+        // It's the memory from MemoryBuffer(), from before the swapchain
+        // was turned off.
+        FreeBuffer(buffer);
+
+    if(win->bufferPool) {
+        if(PoolBuffer(win, buffer, width, height, format))
+            return 0;
+        goto haveBuffer;
+    }
+
+    if(buffer->wl_buffer && (buffer->size > size ||
+                buffer->format != format)) {
         // We can't decrease the size of the buffer without
-        // creating a different buffer.
+        // creating a different buffer.  Same for a different pixel
+        // format.
         FreeBuffer(buffer);
         DASSERT(!buffer->wl_buffer);
     }
+    buffer->format = format;
 
     // We could change the width and height without changing the size.
     // That would be okay, except we just need the values for any
@@ -173,19 +651,87 @@ struct PnBuffer *GetNextBuffer(struct PnWindow *win,
     if(buffer->height != height)
         buffer->height = height;
 
-    if(buffer->wl_buffer && buffer->size == size)
-        // No buffer resize needed.
-        return buffer;
-
     if(!buffer->wl_buffer) {
         if(CreateBuffer(win, buffer, size))
             return 0;
-    } else if(ResizeBuffer(win, buffer, size))
+    } else if(buffer->size != size && ResizeBuffer(win, buffer, size))
+        return 0;
+
+haveBuffer:
+
+    if(!win->numSwapBuffers)
+        return buffer;
+
+    win->nextSwapBuffer = GetSwapBuffer(win);
+    if(!win->nextSwapBuffer) {
+        // The compositor has all our swapchain buffers.  Drawing to
+        // PnWindow::buffer now would be okay, but we would have nowhere
+        // to put the result, so we wait.
+        win->waitingForRelease = true;
         return 0;
+    }
 
     return buffer;
 }
 
+// Mark a window relative rectangle as changed for the Wayland compositor
+// and for all the swapchain buffers (if there are any).
+//
+void DamageBuffer(struct PnWindow *win,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+
+    DASSERT(win);
+    DASSERT(HaveSurface(win));
+
+    if(!d.headless)
+        d.surface_damage_func(win->wl_surface, x, y, width, height);
+
+    for(uint32_t i = 0; i < win->numSwapBuffers; ++i)
+        if(win->swapBuffers[i].buffer.wl_buffer)
+            AddSwapDamage(win->swapBuffers + i, x, y, width, height);
+}
+
+// Returns the wl_buffer to attach to the window's wl_surface after
+// drawing, with all DamageBuffer() calls for this draw done.
+//
+struct wl_buffer *GetAttachBuffer(struct PnWindow *win) {
+
+    DASSERT(win);
+
+    if(!win->numSwapBuffers)
+        return win->buffer.wl_buffer;
+
+    struct PnSwapBuffer *sb = win->nextSwapBuffer;
+    DASSERT(sb);
+    DASSERT(!sb->busy);
+    DASSERT(sb->buffer.wl_buffer);
+    win->nextSwapBuffer = 0;
+
+    // Bring this buffer up to date with all the drawing that happened
+    // since it was last shown, which includes this draw.
+    for(uint32_t i = 0; i < sb->numDamage; ++i)
+        CopyRect(&sb->buffer, &win->buffer, sb->damage + i);
+    sb->numDamage = 0;
+
+    sb->busy = true;
+    return sb->buffer.wl_buffer;
+}
+
+void FreeSwapBuffers(struct PnWindow *win) {
+
+    DASSERT(win);
+
+    for(uint32_t i = 0; i < PN_MAX_SWAP_BUFFERS; ++i) {
+        struct PnSwapBuffer *sb = win->swapBuffers + i;
+        if(sb->buffer.wl_buffer || sb->buffer.fd > -1)
+            FreeBuffer(&sb->buffer);
+        sb->numDamage = 0;
+        sb->busy = false;
+    }
+    win->nextSwapBuffer = 0;
+    win->waitingForRelease = false;
+}
+
 
 void FreeBuffer(struct PnBuffer *buffer) {
 
@@ -94,7 +94,7 @@ void pnWidget_setCairoDraw(struct PnWidget *w,
     w->cairoDrawData = userData;
 
     if(draw && !w->cr && w->window &&
-            w->window->buffer.wl_buffer && !w->culled)
+            HaveBuffer(&w->window->buffer) && !w->culled)
         // This surface, "s", might need a Cairo surface (and Cairo
         // object).
         CreateCairo(&w->window->buffer, w);
@@ -116,7 +116,7 @@ void RecreateCairos(struct PnWindow *win, struct PnWidget *w) {
     DASSERT(buffer->width);
     DASSERT(buffer->height);
     DASSERT(buffer->stride);
-    DASSERT(buffer->wl_buffer);
+    DASSERT(HaveBuffer(buffer));
 
     if(!w) {
         w = &win->widget;
@@ -35,7 +35,7 @@ static void __attribute__((constructor)) constructor(void) {
 
 static void __attribute__((destructor)) destructor(void) {
 
-    if(d.wl_display)
+    if(HaveDisplay())
         pnDisplay_destroy();
 
 #ifdef WITH_CAIRO
@@ -50,6 +50,11 @@ static
 bool pnWindow_setCursor(struct PnWidget *w, const char *name) {
 
     DASSERT(w);
+
+    if(d.headless)
+        // There is no cursor to show.
+        return false;
+
     DASSERT(d.wl_pointer);
     DASSERT(theme);
     DASSERT(d.wl_shm);
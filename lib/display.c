@@ -5,10 +5,12 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-client.h>
 #include <linux/input-event-codes.h>
 #include "xdg-shell-protocol.h"
 #include "xdg-decoration-protocol.h"
+#include "presentation-time-protocol.h"
 
 #include "../include/panels.h"
 #include "debug.h"
@@ -59,31 +61,17 @@ static const struct xdg_wm_base_listener xdg_wm_base_listener = {
 };
 
 
-// This is the window enter event, and also a widget enter.
+// The parts of the pointer events that do not use Wayland objects, so
+// that we can inject pointer events in headless mode (see headless.c).
+// The wl_pointer listener functions below call these.
+
+// Enter window "win".  serial is 0 for an injected event.
 //
-static void enter(void *data,
-        struct wl_pointer *p, uint32_t serial,
-        struct wl_surface *wl_surface, wl_fixed_t x,  wl_fixed_t y) {
+void DoPointerEnter(struct PnWindow *win, uint32_t serial,
+        wl_fixed_t x, wl_fixed_t y) {
 
-    DASSERT(d.wl_display);
-    DASSERT(d.wl_seat);
-    DASSERT(p);
-    DASSERT(d.wl_pointer == p);
- 
+    DASSERT(win);
     DASSERT(!d.pointerWindow);
-    if(!wl_surface)
-        // This happened.  What the shit?
-        return;
-
-    struct PnWindow *win = wl_surface_get_user_data(wl_surface);
-
-    if(!win || !win->wl_surface) {
-        // This can happen if pnPopup_hide() was called.
-        //
-        // The compositor is not in sync with this process; so it does not
-        // know we destroyed the wl_surface in this process.
-        return;
-    }
 
     if((win->widget.type & TOPLEVEL) && d.topMenu)
         // We had active pop-up menus, so now hide them.
@@ -91,9 +79,8 @@ static void enter(void *data,
 
     d.pointerWindow = win;
 
-    d.pointerWindow->lastSerial = serial;
-    DASSERT(serial);
-    DASSERT(d.pointerWindow->wl_surface == wl_surface);
+    if(serial)
+        d.pointerWindow->lastSerial = serial;
     DASSERT(d.pointerWindow->widget.allocation.x == 0);
     DASSERT(d.pointerWindow->widget.allocation.y == 0);
 
@@ -103,13 +90,7 @@ static void enter(void *data,
     DoEnterAndLeave();
 }
 
-static void leave(void *data, struct wl_pointer *p,
-        uint32_t serial, struct wl_surface *wl_surface) {
-
-    DASSERT(d.wl_display);
-    DASSERT(d.wl_seat);
-    DASSERT(p);
-    DASSERT(d.wl_pointer == p);
+void DoPointerLeave(void) {
 
     // Resetting this (lastSerial) brakes the cursor.c code:
     //d.pointerWindow->lastSerial = 0;
@@ -123,24 +104,14 @@ static void leave(void *data, struct wl_pointer *p,
     d.focusWidget = 0;
 }
 
-// Window motion.  Wayland compositor mouse pointer motion event.
-//
-// We use the wayland window motion event, in addition to the wayland
-// window enter event, to generate the libpanels widget enter event.
-//
-static void motion(void *, struct wl_pointer *p, uint32_t,
-        wl_fixed_t x,  wl_fixed_t y) {
+void DoPointerMotion(wl_fixed_t x, wl_fixed_t y) {
 
-    DASSERT(d.wl_display);
-    DASSERT(d.wl_seat);
-    DASSERT(p);
-    DASSERT(d.wl_pointer == p);
     if(!d.pointerWindow) return;
     //DASSERT(d.pointerWidget);
     //DASSERT(d.pointerWindow);
 
     struct PnWindow *win = d.pointerWindow;
-    if(!win || !win->wl_surface) {
+    if(!win || !HaveSurface(win)) {
         // This can happen if pnPopup_hide() was called.
         //
         // The compositor is not in sync with this process; so it does not
@@ -215,15 +186,7 @@ static void motion(void *, struct wl_pointer *p, uint32_t,
         DoMotion(d.focusWidget);
 }
 
-static void button(void *, struct wl_pointer *p,
-        uint32_t serial,
-        uint32_t time,
-        uint32_t button, uint32_t state) {
-
-    DASSERT(d.wl_display);
-    DASSERT(d.wl_seat);
-    DASSERT(p);
-    DASSERT(d.wl_pointer == p);
+void DoPointerButton(uint32_t button, uint32_t state) {
 
     if(!d.focusWidget) return;
 
@@ -313,6 +276,140 @@ static void button(void *, struct wl_pointer *p,
     //DSPEW("button=%" PRIu32 " state=%" PRIu32, button, state);
 }
 
+void DoPointerAxis(uint32_t time, uint32_t which, double value) {
+
+    // TODO: Should the button grab widget take this first?
+    // I'm thinking no.
+
+    for(struct PnWidget *s = d.focusWidget; s; s = s->parent)
+        if(s->axis && s->axis(s, time, which, value, s->axisData))
+            return;
+}
+
+
+// This is the window enter event, and also a widget enter.
+//
+static void enter(void *data,
+        struct wl_pointer *p, uint32_t serial,
+        struct wl_surface *wl_surface, wl_fixed_t x,  wl_fixed_t y) {
+
+    DASSERT(d.wl_display);
+    DASSERT(d.wl_seat);
+    DASSERT(p);
+    DASSERT(d.wl_pointer == p);
+ 
+    DASSERT(!d.pointerWindow);
+    if(!wl_surface)
+        // This happened.  What the shit?
+        return;
+
+    struct PnWindow *win = wl_surface_get_user_data(wl_surface);
+
+    if(!win || !win->wl_surface) {
+        // This can happen if pnPopup_hide() was called.
+        //
+        // The compositor is not in sync with this process; so it does not
+        // know we destroyed the wl_surface in this process.
+        return;
+    }
+
+    DASSERT(serial);
+    DASSERT(win->wl_surface == wl_surface);
+
+    DoPointerEnter(win, serial, x, y);
+}
+
+static void leave(void *data, struct wl_pointer *p,
+        uint32_t serial, struct wl_surface *wl_surface) {
+
+    DASSERT(d.wl_display);
+    DASSERT(d.wl_seat);
+    DASSERT(p);
+    DASSERT(d.wl_pointer == p);
+
+    FlushPointerMotion();
+    DoPointerLeave();
+}
+
+// Does the widget that gets the motion callbacks want all of them?
+//
+static inline bool WantsAllMotion(void) {
+
+    struct PnWidget *w = d.buttonGrabWidget ?
+            d.buttonGrabWidget : d.focusWidget;
+    for(; w; w = w->parent)
+        if(w->motion)
+            return w->allMotion;
+    return false;
+}
+
+void FlushPointerMotion(void) {
+
+    if(!d.motionPending) return;
+
+    d.motionPending = false;
+    DoPointerMotion(d.motionX, d.motionY);
+}
+
+// Window motion.  Wayland compositor mouse pointer motion event.
+//
+// We use the wayland window motion event, in addition to the wayland
+// window enter event, to generate the libpanels widget enter event.
+//
+// A fast mouse can send us 1000 motion events a second, and we only
+// draw at the frame rate; so we just save the position here and act on
+// the last one after we dispatch all the events we read at once, or
+// before another pointer event or a window draw, in
+// FlushPointerMotion().  Finding the widget and calling the motion
+// callbacks for the positions in between is a waste, unless the widget
+// asked for them with pnWidget_setAllMotion().
+//
+// We only save it if we are in one of our dispatch paths, which flush
+// it after the events are dispatched.  If the user's code dispatches
+// the events nothing would flush the last one until some other event
+// came, which may be never.
+//
+// The headless pnWindow_injectPointerMotion() calls this too.
+//
+void PointerMotion(wl_fixed_t x, wl_fixed_t y) {
+
+    if(!d.dispatching || WantsAllMotion()) {
+        FlushPointerMotion();
+        DoPointerMotion(x, y);
+        return;
+    }
+
+    d.motionX = x;
+    d.motionY = y;
+    d.motionPending = true;
+}
+
+static void motion(void *, struct wl_pointer *p, uint32_t,
+        wl_fixed_t x,  wl_fixed_t y) {
+
+    DASSERT(d.wl_display);
+    DASSERT(d.wl_seat);
+    DASSERT(p);
+    DASSERT(d.wl_pointer == p);
+
+    PointerMotion(x, y);
+}
+
+static void button(void *, struct wl_pointer *p,
+        uint32_t serial,
+        uint32_t time,
+        uint32_t button, uint32_t state) {
+
+    DASSERT(d.wl_display);
+    DASSERT(d.wl_seat);
+    DASSERT(p);
+    DASSERT(d.wl_pointer == p);
+
+    // The press or release is at the last motion position.
+    FlushPointerMotion();
+    DoPointerButton(button, state);
+}
+
 static void axis(void *userData, struct wl_pointer *p, uint32_t time,
         uint32_t which, wl_fixed_t value) {
 
@@ -323,13 +420,8 @@ static void axis(void *userData, struct wl_pointer *p, uint32_t time,
     //INFO("time=%" PRIu32 " which=%" PRIu32 " value=%16.16lf",
     //        time, which, wl_fixed_to_double(value));
 
-    // TODO: Should the button grab widget take this first?
-    // I'm thinking no.
-
-    for(struct PnWidget *s = d.focusWidget; s; s = s->parent)
-        if(s->axis && s->axis(s, time, which,
-                wl_fixed_to_double(value), s->axisData))
-            return;
+    FlushPointerMotion();
+    DoPointerAxis(time, which, wl_fixed_to_double(value));
 }
 
 
@@ -458,6 +550,36 @@ static inline void FreeOutput(struct PnOutput *output) {
 }
 
 
+static void shm_format(void *data, struct wl_shm *wl_shm,
+        uint32_t format) {
+
+    DASSERT(d.wl_shm == wl_shm);
+
+    d.shmFormats = realloc(d.shmFormats,
+            (d.numShmFormats + 1)*sizeof(*d.shmFormats));
+    ASSERT(d.shmFormats, "realloc(,%zu) failed",
+            (d.numShmFormats + 1)*sizeof(*d.shmFormats));
+    d.shmFormats[d.numShmFormats++] = format;
+}
+
+static const struct wl_shm_listener shm_listener = {
+    .format = shm_format
+};
+
+
+static void presentation_clock_id(void *data,
+        struct wp_presentation *wp_presentation, uint32_t clk_id) {
+
+    DASSERT(d.wp_presentation == wp_presentation);
+    // The presentation times are from this clock.
+    d.presentationClock = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id
+};
+
+
 static void handle_global(void *data, struct wl_registry *registry,
             uint32_t name, const char *interface, uint32_t version) {
 
@@ -473,6 +595,11 @@ static void handle_global(void *data, struct wl_registry *registry,
         if(!d.wl_shm) {
             ERROR("wl_registry_bind(,,) for shm failed");
             d.handle_global_error = 1;
+            return;
+        }
+        if(wl_shm_add_listener(d.wl_shm, &shm_listener, 0)) {
+            ERROR("wl_shm_add_listener() failed");
+            d.handle_global_error = 1;
         }
     } else if(!strcmp(interface, wl_seat_interface.name)) {
         // I'm guessing we can only get one wayland seat.
@@ -515,6 +642,19 @@ static void handle_global(void *data, struct wl_registry *registry,
             d.handle_global_error = 7;
             return;
         }
+    } else if(!strcmp(interface, wp_presentation_interface.name)) {
+        d.wp_presentation = wl_registry_bind(registry, name,
+	        &wp_presentation_interface, 1);
+        if(!d.wp_presentation) {
+            ERROR("wl_registry_bind(,,) for wp_presentation failed");
+            d.handle_global_error = 10;
+            return;
+        }
+        if(wp_presentation_add_listener(d.wp_presentation,
+                    &presentation_listener, 0)) {
+            ERROR("wp_presentation_add_listener(,,) failed");
+            d.handle_global_error = 11;
+        }
     } else if(strcmp(interface, wl_output_interface.name) == 0) {
         // Add a Wayland output (monitor thingy).
         //
@@ -619,6 +759,28 @@ int _pnDisplay_create(void) {
     // orphaned widgets.  Orphaned widgets may get parents later.
     d.widget.type = DISPLAY;
 
+    d.shmFlags = GetShmFlagsFromEnv();
+    d.presentationClock = CLOCK_MONOTONIC;
+    d.pacingFd = -1;
+    d.flushFd = -1;
+
+    // Other threads can post as soon as they can see the display, so we
+    // make this first.
+    if(InitPosts())
+        return 1;
+
+    const char *env = getenv("PN_HEADLESS");
+    if(env && env[0] && strcmp(env, "0"))
+        d.headless = true;
+
+    if(d.headless) {
+        // No Wayland compositor, no Wayland objects.  See headless.c.
+        if(!d.headlessRefresh)
+            d.headlessRefresh = PN_HEADLESS_REFRESH;
+        INFO("Running headless with no Wayland compositor");
+        return 0;
+    }
+
     d.wl_display = wl_display_connect(0);
     RET_ERROR(d.wl_display, 1, "wl_display_connect() failed");
 
@@ -664,6 +826,10 @@ int _pnDisplay_create(void) {
         // This will happen on a GNOME 3 wayland desktop.
         NOTICE("cannot get zxdg_decoration_manager");
 
+    if(!d.wp_presentation)
+        // We'll estimate frame times from wl_callback events.
+        INFO("cannot get wp_presentation");
+
     // It looks like we do not get the pointer and the keyboard until we
     // call wl_display_dispatch().
     int err = 0;
@@ -692,7 +858,7 @@ static inline void FreeTheme(void) {
 
 static void _pnDisplay_destroy(void) {
 
-    DASSERT(d.wl_display);
+    DASSERT(HaveDisplay());
 
     // Destroy stuff in reverse order of creation, pretty much.
 
@@ -709,6 +875,11 @@ static void _pnDisplay_destroy(void) {
         // Which destroys all the widgets in them.
         pnWidget_destroy(&d.windows->widget);
 
+    DestroyDrawWorkers();
+
+    if(d.wp_presentation)
+        wp_presentation_destroy(d.wp_presentation);
+
     if(d.zxdg_decoration_manager)
         zxdg_decoration_manager_v1_destroy(d.zxdg_decoration_manager);
 
@@ -752,16 +923,29 @@ static void _pnDisplay_destroy(void) {
     if(d.wl_shm)
         wl_shm_destroy(d.wl_shm);
 
+    if(d.shmFormats) {
+        DZMEM(d.shmFormats, d.numShmFormats*sizeof(*d.shmFormats));
+        free(d.shmFormats);
+    }
+
     if(d.wl_registry)
         wl_registry_destroy(d.wl_registry);
 
-    wl_display_disconnect(d.wl_display);
+    if(d.wl_display)
+        wl_display_disconnect(d.wl_display);
 
     FreeTheme();
 
     if(d.mainLoop)
         pnMainLoop_destroy(d.mainLoop);
 
+    if(d.pacingFd >= 0)
+        // After the main loop lets go of it.
+        close(d.pacingFd);
+    if(d.flushFd >= 0)
+        close(d.flushFd);
+    DestroyPosts();
+
     memset(&d, 0, sizeof(d));
 }
 
@@ -787,7 +971,7 @@ int pnDisplay_create(void) {
 
     // So many things in this function can fail.
 
-    ASSERT(!d.wl_display);
+    ASSERT(!HaveDisplay());
 
     int ret = _pnDisplay_create();
 
@@ -804,7 +988,7 @@ int pnDisplay_create(void) {
 //
 void pnDisplay_destroy(void) {
 
-    if(!d.wl_display) {
+    if(!HaveDisplay()) {
         // The whole struct PnDisplay should be zeros.  Lets check a few
         // parts.
         DASSERT(!d.wl_display);
@@ -824,7 +1008,7 @@ void pnDisplay_destroy(void) {
 
 bool pnDisplay_haveXDGDecoration(void) {
 
-    if(!d.wl_display)
+    if(!HaveDisplay())
         _pnDisplay_create();
 
     return (bool) d.zxdg_decoration_manager;
@@ -833,7 +1017,7 @@ bool pnDisplay_haveXDGDecoration(void) {
 
 void pnDisplay_setTheme(const char *theme) {
 
-    if(!d.wl_display)
+    if(!HaveDisplay())
         _pnDisplay_create();
 
     FreeTheme();
@@ -843,3 +1027,13 @@ void pnDisplay_setTheme(const char *theme) {
         ASSERT(d.theme, "strdup() failed");
     }
 }
+
+
+void pnDisplay_setShmFlags(uint32_t flags) {
+
+    if(!HaveDisplay())
+        _pnDisplay_create();
+
+    // This effects the buffers that are made after this call.
+    d.shmFlags = flags;
+}
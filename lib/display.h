@@ -1,9 +1,33 @@
 
+#include <sys/mman.h>
+#include <stdatomic.h>
+
 #ifdef WITH_CAIRO
 #include <cairo/cairo.h>
 #endif
 
 
+// A function call posted from any thread to be called in the main loop.
+// See post.c.
+struct PnPost {
+    void (*func)(void *data);
+    void *data;
+    _Atomic(struct PnPost *) next;
+    // Set if we malloc(3)ed it, and free it after the call.
+    bool allocated;
+};
+
+// A lock-free queue of PnPost with many producers (threads calling
+// pnDisplay_post()) and one consumer (the main loop).  Producers add at
+// the head, and the consumer takes from the tail.
+struct PnPostQueue {
+    _Atomic(struct PnPost *) head;
+    struct PnPost *tail;
+    // So the queue is never empty.
+    struct PnPost stub;
+};
+
+
 // CAUTION: We bit diddle for widget types using just a 32 bit int.
 //
 // TODO: This limits the number of types of widgets we can have in
@@ -232,6 +256,10 @@ struct PnAction {
     uint32_t actionIndex;
 };
 
+// The most rectangles that pnWidget_queueDrawRect() keeps for a widget.
+// More than that and we use the bounding box of them.
+#define PN_MAX_DIRTY_RECTS  (4)
+
 // surface type PnWidgetType_widget
 //
 // Widgets do not have a Wayland surface (wl_surface) or other related
@@ -304,6 +332,10 @@ struct PnWidget {
             int32_t x, int32_t y,
             void *userData);
     void *motionData;
+    // Set with pnWidget_setAllMotion() to get a motion callback for
+    // every pointer motion event, and not just the last of the ones
+    // that we read at once.
+    bool allMotion;
     bool (*axis)(struct PnWidget *w,
             uint32_t time,
             uint32_t which, double value,
@@ -475,6 +507,18 @@ struct PnWidget {
 
     // Is in the window draw queue.
     bool isQueued;
+    // The parts of the widget that need drawing from
+    // pnWidget_queueDrawRect(), in window coordinates.  numDirty is 0
+    // if all of the widget needs drawing.
+    struct PnAllocation dirty[PN_MAX_DIRTY_RECTS];
+    uint32_t numDirty;
+    // The PnWindow::frame of the draw queue that this is in, if
+    // isQueued.
+    uint32_t queueFrame;
+
+    // For pnWidget_postDraw() from other threads.  drawPost is the
+    // allocated post in the post queue, or 0 if there is none.
+    _Atomic(struct PnPost *) drawPost;
 
     // "needAllocate" is a flag to said that we need to recompute all
     // widget allocations for this widget and children below, that is
@@ -483,6 +527,19 @@ struct PnWidget {
     // RecreateCairos().
     //
     bool needAllocate;
+    // Set with needAllocate when just the children of this widget need
+    // new allocations, and this widget keeps its allocation.  See
+    // RelayoutChanged() in allocation.c.
+    bool allocateChildren;
+
+    // The shrink wrapped (natural) size, culling, and expandability of
+    // this widget from the last time we got the allocations.  They are
+    // only good if PnWindow::naturalValid is set.  pnWidget_show() and
+    // pnWidget_setSize() use them to redo the allocations of part of the
+    // window, and not all of it.
+    uint32_t naturalWidth, naturalHeight;
+    enum PnExpand naturalExpand;
+    bool naturalCulled;
 };
 
 struct PnBuffer {
@@ -492,19 +549,124 @@ struct PnBuffer {
 
     size_t size; // total bytes of mapped shared memory file
 
-    // stride is the distance in uint32_t (4 byte) chunks.
+    // stride is the distance in pixels; for the 4 byte pixel formats
+    // that's in uint32_t (4 byte) chunks.
     uint32_t width, height, stride;
 
+    // WL_SHM_FORMAT_ARGB8888 (which is 0), WL_SHM_FORMAT_XRGB8888, or
+    // WL_SHM_FORMAT_RGB565.  Only swapchain buffers can be RGB565; the
+    // buffer that widgets draw to is always 4 bytes per pixel.
+    uint32_t format;
+
     // pixels is a pointer to the share memory pixel data from mmap(2).
     uint32_t *pixels;
 
     int fd; // File descriptor to shared memory file
 };
 
+// The maximum number of wl_buffers in a window's optional swapchain.  See
+// pnWindow_setNumBuffers().
+#define PN_MAX_SWAP_BUFFERS  (3)
+// The number of damage rectangles we keep per swapchain buffer before we
+// give up and merge them all into one bounding box.
+#define PN_MAX_SWAP_DAMAGE   (32)
+
+// A wl_buffer that we hand to the Wayland compositor in the optional
+// swapchain mode.  In swapchain mode all the widgets still draw to the
+// window's PnWindow::buffer, which is then just memory that the
+// compositor never sees (see MemoryBuffer() in buffer.c), so the Cairo
+// surfaces and beam plot pixel pointers never need to change as we
+// switch between buffers; we just copy the regions that changed since a
+// swapchain buffer was last shown from PnWindow::buffer to it just before
+// we attach it.  That way we never write to a buffer that the compositor
+// may be reading from, and we do not copy the whole window for each
+// frame.
+//
+struct PnSwapBuffer {
+
+    struct PnBuffer buffer;
+
+    struct PnWindow *window;
+
+    // Regions (window relative) of PnWindow::buffer that have changed
+    // since this buffer was last shown (attached).
+    struct PnAllocation damage[PN_MAX_SWAP_DAMAGE];
+    uint32_t numDamage;
+
+    // busy is set from when we attach this to the wl_surface until the
+    // compositor sends the wl_buffer release event.
+    bool busy;
+};
+
 struct PnDrawQueue {
     struct PnWidget *first, *last;
 };
 
+// The most damage rectangles we send to the compositor for one frame.
+// pnWindow_setMaxDamageRects() can set a smaller number.
+#define PN_MAX_DAMAGE_RECTS     (64)
+#define PN_DEFAULT_DAMAGE_RECTS (16)
+
+// A widget from the draw queue that we draw with the draw worker
+// threads.  See drawWorkers.c.
+struct PnDrawItem {
+    struct PnWidget *widget;
+    // A copy of the widget's dirty rectangles before it was drawn.
+    struct PnAllocation dirty[PN_MAX_DIRTY_RECTS];
+    uint32_t numDirty;
+    uint32_t widgets; // number of widgets drawn
+    // Items in a batch do not overlap, and are drawn at the same time.
+    uint32_t batch;
+};
+
+struct PnDrawWorkers;
+
+// The number of frames we keep in the frame statistics ring.  See
+// frameStats.c.
+#define PN_FRAME_STATS  (128)
+
+// What we measured for one frame.
+struct PnFrameRecord {
+    uint64_t commitTime; // FrameClock() at wl_surface_commit()
+    // Nanoseconds it took to get the widget allocations (layout), draw
+    // the widgets, and then do the damage, attach, and commit.
+    uint32_t layout, draw, commit;
+    // Nanoseconds from the commit to the frame being shown (from
+    // wp_presentation), or to the next wl_callback without it.  0 if
+    // we don't know it.
+    uint32_t latency;
+    uint32_t widgets; // number of widgets drawn
+    uint32_t damagedPixels;
+};
+
+// The most bins in a window's PnFindIndex.
+#define PN_FIND_MAX_BINS  (16384)
+
+// A uniform grid of square bins over a window that we use to find the
+// widget with the pointer in it without searching the whole widget tree
+// at each pointer motion event.  See eventFindXY.c.
+struct PnFindIndex {
+
+    // Bins are (1 << shift) pixels on a side, numX across and numY
+    // down.
+    uint32_t shift, numX, numY;
+
+    // The leaf widgets (widgets with no children) that share pixels
+    // with bin i are leaves[start[i]] to leaves[start[i+1]-1].
+    uint32_t *start;
+    struct PnWidget **leaves;
+    // owner[i] is the most childish widget that has all of bin i in it.
+    struct PnWidget **owner;
+
+    uint32_t numLeaves;
+    // Allocated array sizes.  We keep the arrays between rebuilds.
+    uint32_t maxBins, maxLeaves;
+
+    // Unset when the allocations of the widgets in the window change,
+    // so we rebuild it at the next find.
+    bool valid;
+};
+
 // widget surface type (widget.type) can be a toplevel or a popup
 struct PnWindow {
 
@@ -522,6 +684,9 @@ struct PnWindow {
     // method.
     struct PnDrawQueue *dqRead, *dqWrite;
     struct PnDrawQueue drawQueues[2];
+    // A count of the times we switched the draw queues.  Widgets
+    // queued in dqWrite get PnWidget::queueFrame = frame.
+    uint32_t frame;
 
     // To keep:
     //    1. a list of toplevel windows in the display, or
@@ -569,6 +734,81 @@ struct PnWindow {
     struct wl_callback *wl_callback;
     struct PnBuffer buffer; // made fifth (and many times for toplevel)
 
+    // Optional swapchain.  numSwapBuffers is 0 (the default) to draw
+    // to and attach just PnWindow::buffer, otherwise we attach one of
+    // swapBuffers[] that the compositor has released.
+    struct PnSwapBuffer swapBuffers[PN_MAX_SWAP_BUFFERS];
+    uint32_t numSwapBuffers;
+    // The swapchain buffer that GetNextBuffer() found not busy, that we
+    // attach at the end of the current draw.
+    struct PnSwapBuffer *nextSwapBuffer;
+    // Set if we could not draw because all the swapchain buffers were
+    // busy.  We retry when we get a wl_buffer release event.
+    bool waitingForRelease;
+
+    // Set with pnWindow_setBufferPool().  Over-allocate the shared
+    // memory so that window resizes do not remap it each time.
+    bool bufferPool;
+
+    // Set with pnWindow_setPixelFormat().
+    enum PnPixelFormat pixelFormat;
+    // With PnPixelFormat_auto, set if the window and all the widgets in
+    // it have opaque background colors.  checkOpaque is set when that
+    // needs checking again.  See CheckOpaque() in buffer.c.
+    bool opaque, checkOpaque;
+
+    // The damage rectangles for the frame being drawn in DrawFromQueue().
+    // Overlapping and adjacent rectangles get merged as they are added,
+    // and if there are more than maxDamageRects we use the bounding box
+    // of them all.
+    struct PnAllocation frameDamage[PN_MAX_DAMAGE_RECTS];
+    uint32_t numFrameDamage;
+    uint32_t maxDamageRects; // 0 for PN_DEFAULT_DAMAGE_RECTS
+
+    // Running totals of the pixels that widgets drew and the pixels that
+    // we told the compositor changed.  See pnWindow_getPixelCounts().
+    uint64_t drawnPixels, damagedPixels;
+
+    // A ring of the last PN_FRAME_STATS frames that we drew, for
+    // pnWindow_getFrameStats().  The frame number numFrames is the next
+    // one, and it goes in frameStats[numFrames % PN_FRAME_STATS].
+    struct PnFrameRecord frameStats[PN_FRAME_STATS];
+    uint64_t numFrames;
+    // Counts the widgets that pnSurface_draw() draws.
+    uint32_t widgetsDrawn;
+
+    // Frame timing, see presentation.c.  All the times are in
+    // nanoseconds from the presentation clock, d.presentationClock.
+    //
+    // We keep at most one wp_presentation_feedback waiting at a time.
+    struct wp_presentation_feedback *feedback;
+    uint64_t feedbackFrame; // the frame number the feedback is for
+    uint64_t presentTime; // when the last frame was shown, or 0
+    // The refresh period of the monitor from wp_presentation, or 0 if
+    // we do not know it.  callbackRefresh is our estimate of it from
+    // the wl_callback time stamps, for when the compositor does not
+    // have wp_presentation.
+    uint64_t refresh, callbackRefresh;
+    uint64_t callbackTime; // when we got the last wl_callback
+    uint32_t lastCallbackMSec; // the time stamp from that wl_callback
+    // A decaying maximum of the time it takes to draw a frame.
+    uint64_t drawEstimate;
+
+    // Frame pacing, set with pnWindow_setFramePacing().  If pacingMargin
+    // is not 0 we wait until drawEstimate plus pacingMargin (in
+    // nanoseconds) before the next predicted refresh to draw, so that
+    // the frame shows the newest data.  pacingPending is set while we
+    // wait, and pacingDeadline is when we draw.
+    uint64_t pacingMargin;
+    uint64_t pacingDeadline;
+    bool pacingPending;
+
+    // Headless mode, see headless.c.  headlessShown is set from when the
+    // window is shown until it's hidden (popups), and headlessFrame is
+    // set in place of a wl_callback when we need a frame at the next
+    // synthetic clock tick.
+    bool headlessShown, headlessFrame;
+
 
     void (*destroy)(struct PnWidget *window, void *userData);
     void *destroyData;
@@ -588,6 +828,16 @@ struct PnWindow {
     //
     bool needDraw;
 
+    // Set when the PnWidget::natural* values in this window's widgets
+    // are good.  We get them when the allocations were done without
+    // clipping or culling widgets for lack of space, and without
+    // splitter containers, which change widget sizes while they are
+    // allocated.
+    bool naturalValid;
+
+    // For finding the widget at an x,y position in the window.
+    struct PnFindIndex findIndex;
+
     // This is a flag that is set in a wl_callback that lets us know that
     // the window is very likely being shown to the user.  We know that
     // the pixel buffer was drawn to, and we have waited for one
@@ -703,6 +953,9 @@ struct PnDisplay {
     struct wl_display *wl_display;                              // 1
     struct wl_registry *wl_registry;                            // 2
     struct wl_shm *wl_shm;                                      // 3
+    // The pixel formats that wl_shm told us it has.
+    uint32_t *shmFormats;
+    uint32_t numShmFormats;
     struct wl_compositor *wl_compositor;                        // 4
     struct xdg_wm_base *xdg_wm_base;                            // 5
     struct wl_seat *wl_seat;                                    // 6
@@ -711,6 +964,10 @@ struct PnDisplay {
     struct zxdg_decoration_manager_v1 *zxdg_decoration_manager; // 9
     struct PnOutput **outputs; // array of monitors pointers    //10 + more
     uint32_t numOutputs;
+    // Optional.  If we do not get it we estimate frame times from
+    // wl_callback time stamps.  See presentation.c.
+    struct wp_presentation *wp_presentation;
+    uint32_t presentationClock; // a clockid_t from wp_presentation
 
     uint32_t handle_global_error;
 
@@ -750,6 +1007,17 @@ struct PnDisplay {
     // motion events.
     int32_t x, y; // pointer position.
 
+    // The last pointer motion event, that we have not acted on yet.
+    // See FlushPointerMotion() in display.c.
+    wl_fixed_t motionX, motionY;
+    bool motionPending;
+    // Set while the libpanels dispatch paths in run.c dispatch Wayland
+    // events; they call FlushPointerMotion() after.  Programs that
+    // dispatch the events themselves, like with
+    // wl_display_dispatch_pending() on pnDisplay_getWaylandDisplay(), do
+    // not, so then we do not save motion for later.
+    bool dispatching;
+
     struct PnWidget *buttonGrabWidget;
     // First bit left, second bit middle, third bit right.
     uint32_t buttonGrab;
@@ -766,6 +1034,49 @@ struct PnDisplay {
 
     // Optional main loop stuff:
     struct PnMainLoop *mainLoop;
+
+    // enum PnShm bits from the PN_SHM environment variable or
+    // pnDisplay_setShmFlags().
+    uint32_t shmFlags;
+
+    // Optional threads that draw the queued widgets of a window in
+    // parallel.  Set with pnDisplay_setDrawThreads().
+    struct PnDrawWorkers *drawWorkers;
+
+    // One timerfd for all windows that use frame pacing.  It is a reader
+    // in the main loop.  -1 if we have not made it yet.
+    int pacingFd;
+    // When pacingFd is set to expire, or 0 if it is not set.
+    uint64_t pacingTimeout;
+    // Set while pnDisplay_run() runs the main loop, which is the only
+    // thing that reads pacingFd.  We only pace frames while it's set.
+    bool mainLoopRunning;
+
+    // A dup(2) of the Wayland display fd.  It's a main loop writer, just
+    // while wl_display_flush() could not write all of its requests to
+    // the compositor (flushPending).  It's a dup because epoll(7) takes
+    // a file descriptor just once, and the Wayland fd is a reader.  -1
+    // if we have not made it yet.
+    int flushFd;
+    bool flushPending;
+
+    // Function calls posted from other threads, and the eventfd that
+    // wakes the main loop for them.  postWake is set when we wrote to
+    // postFd and have not read the posts yet, so other posts do not
+    // need to write to it.  numPosts is the number of posts that are
+    // in the queue, or going in, and not called yet.
+    struct PnPostQueue posts;
+    int postFd;
+    atomic_bool postWake;
+    _Atomic uint32_t numPosts;
+
+    // Set with pnDisplay_setHeadless() or the PN_HEADLESS environment
+    // variable.  We have no Wayland compositor, so none of the Wayland
+    // objects above are made.  See headless.c.
+    bool headless;
+    // The synthetic clock in nanoseconds, and how much it moves for
+    // each frame.
+    uint64_t headlessTime, headlessRefresh;
 };
 
 
@@ -790,14 +1101,33 @@ extern int pnDisplay_create(void);
 extern void pnDisplay_destroy(void);
 
 extern void _pnWidget_getAllocations(struct PnWidget *w);
+extern bool RelayoutChanged(struct PnWidget *s);
+
+// Has the display been made?  It's made with a Wayland display
+// connection, or without one in headless mode.
+static inline bool HaveDisplay(void) {
+    return (d.wl_display || d.headless);
+}
 
 // Returns false on success
 static inline bool CheckDisplay(void) {
-    if(!d.wl_display) pnDisplay_create();
+    if(!HaveDisplay()) pnDisplay_create();
     // At this point this may be called from a window create function
     // so we have to assume that we have a working display, if not
     // this returns true.
-    return (bool) !d.wl_display;
+    return (bool) !HaveDisplay();
+}
+
+// Can we draw the window?  In headless mode there is no wl_surface, so
+// we go by whether it's shown.
+static inline bool HaveSurface(const struct PnWindow *win) {
+    return d.headless ? win->headlessShown : (bool) win->wl_surface;
+}
+
+// Does the buffer have pixel memory?  In headless mode, and for the
+// window buffer in swapchain mode, there is no wl_buffer.
+static inline bool HaveBuffer(const struct PnBuffer *buffer) {
+    return (buffer->pixels != MAP_FAILED);
 }
 
 
@@ -834,10 +1164,35 @@ static bool inline HaveChildren(const struct PnWidget *s) {
 
 extern const struct wl_output_listener output_listener;
 
+static inline bool HaveShmFormat(uint32_t format) {
+
+    // ARGB8888 and XRGB8888 are required by the Wayland protocol.
+    if(format == WL_SHM_FORMAT_ARGB8888 ||
+            format == WL_SHM_FORMAT_XRGB8888)
+        return true;
+
+    for(uint32_t i = 0; i < d.numShmFormats; ++i)
+        if(d.shmFormats[i] == format)
+            return true;
+    return false;
+}
+
+// Bytes per pixel of the wl_shm format.
+static inline uint32_t PixelSize(uint32_t format) {
+    return (format == WL_SHM_FORMAT_RGB565) ? 2 : 4;
+}
+
 extern int create_shm_file(size_t size);
+extern void *map_shm_file(int fd, size_t size);
+extern uint32_t GetShmFlagsFromEnv(void);
 extern struct PnBuffer *GetNextBuffer(struct PnWindow *win,
         uint32_t width, uint32_t height);
+extern bool CheckOpaque(struct PnWindow *win);
 extern void FreeBuffer(struct PnBuffer *buffer);
+extern void FreeSwapBuffers(struct PnWindow *win);
+extern void DamageBuffer(struct PnWindow *win,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+extern struct wl_buffer *GetAttachBuffer(struct PnWindow *win);
 
 extern bool InitToplevel(struct PnWindow *win);
 extern bool InitPopup(struct PnWindow *win,
@@ -855,16 +1210,66 @@ extern void RemoveChildSurface(struct PnWidget *parent,
 extern void DestroySurface(struct PnWidget *s);
 extern void DestroySurfaceChildren(struct PnWidget *s);
 
-extern void pnSurface_draw(const struct PnWidget *s,
+extern uint32_t pnSurface_draw(const struct PnWidget *s,
         const struct PnBuffer *buffer, bool config);
 
 extern void FlushDrawQueue(struct PnWindow *win);
 extern bool _pnWindow_addCallback(struct PnWindow *win);
 extern void PostDraw(struct PnWindow *win, struct PnBuffer *buffer);
 extern bool DrawFromQueue(struct PnWindow *win);
+extern void QueueAllocateChildren(struct PnWidget *s);
+extern void _pnWindow_drawFrame(struct PnWindow *win);
+extern void FrameDone(struct PnWindow *win, uint32_t msec);
+
+// headless.c
+//
+// The default time between headless frames in nanoseconds, 60 Hz.
+#define PN_HEADLESS_REFRESH  (16666667)
+extern bool HeadlessDispatch(void);
+
+// post.c
+extern bool InitPosts(void);
+extern void DestroyPosts(void);
+extern int PostRead(int fd, void *userData);
+extern void DoPosts(void);
+extern void UnpostWidget(struct PnWidget *w);
+
+// presentation.c
+extern uint64_t FrameClock(void);
+extern uint64_t MonotonicTime(uint64_t t);
+extern void AddFeedback(struct PnWindow *win);
+extern void FrameCallbackTime(struct PnWindow *win, uint32_t msec);
+extern void AddDrawTime(struct PnWindow *win, uint64_t startTime);
+extern bool PaceFrame(struct PnWindow *win);
+extern bool InitFramePacing(void);
+extern void ExpireFramePacing(void);
+extern void StopFrameTiming(struct PnWindow *win);
+
+// drawWorkers.c
+extern void LockDrawQueue(void);
+extern void UnlockDrawQueue(void);
+extern void AddDrawItem(struct PnWidget *s,
+        const struct PnAllocation *dirty, uint32_t numDirty);
+extern struct PnDrawItem *DrawItems(const struct PnBuffer *buffer,
+        uint32_t *num);
+extern void DestroyDrawWorkers(void);
+
+// frameStats.c
+extern void AddFrameRecord(struct PnWindow *win, uint64_t layout,
+        uint64_t draw, uint64_t commitStart, uint64_t damagedPixels);
+extern void SetFrameLatency(struct PnWindow *win, uint64_t frame,
+        uint64_t t);
 
 extern void GetSurfaceWithXY(const struct PnWindow *win,
         wl_fixed_t x,  wl_fixed_t y, bool isEnter);
+extern void FreeFindIndex(struct PnWindow *win);
+
+// The widget allocations in the window changed, or widgets were added
+// or removed, so the window's PnFindIndex is no good.
+static inline void InvalidateFindIndex(struct PnWindow *win) {
+    if(win)
+        win->findIndex.valid = false;
+}
 
 #ifdef WITH_CAIRO
 extern void HidePopupMenus(void);
@@ -880,6 +1285,17 @@ extern void DoEnterAndLeave(void);
 extern void GetPointerSurface(void);
 // Calls motion() callback until a widget callback returns true.
 extern void DoMotion(struct PnWidget *s);
+// The wl_pointer events without the Wayland parts, so we can inject
+// pointer events in headless mode.
+extern void DoPointerEnter(struct PnWindow *win, uint32_t serial,
+        wl_fixed_t x, wl_fixed_t y);
+extern void DoPointerLeave(void);
+extern void DoPointerMotion(wl_fixed_t x, wl_fixed_t y);
+extern void DoPointerButton(uint32_t button, uint32_t state);
+extern void DoPointerAxis(uint32_t time, uint32_t which, double value);
+// Act on the last pointer motion event, if we have not yet.
+extern void FlushPointerMotion(void);
+extern void PointerMotion(wl_fixed_t x, wl_fixed_t y);
 
 
 extern void LoadCursorTheme(void);
@@ -43,6 +43,8 @@ static inline void RemoveFromDrawQueue(struct PnDrawQueue *q,
     DASSERT(q->last);
 
     s->isQueued = false;
+    s->numDirty = 0;
+    s->allocateChildren = false;
 
     if(s->dqNext) {
         DASSERT(s != q->last);
@@ -65,53 +67,139 @@ static inline void RemoveFromDrawQueue(struct PnDrawQueue *q,
     s->dqNext = 0;
 }
 
-// This function calls itself.
+// Returns the top most ancestor of "s" that is queued to draw in the
+// given frame, or 0 if there is none.  A queued ancestor draws all its
+// children, so "s" does not need to be drawn by itself.
 //
-// Check and dequeue all children from a window draw queue.
-static void DequeueChildren(struct PnDrawQueue *q, struct PnWidget *s) {
+// This is O(depth) and not O(subtree) like the DequeueChildren() that we
+// had before, which walked all the children (every grid cell too) every
+// time a container was queued.  Now descendants can stay in the queue
+// and we skip them at draw time.
+//
+static inline struct PnWidget *QueuedAncestor(struct PnWidget *s,
+        uint32_t frame) {
+
+    struct PnWidget *a = 0;
+    for(struct PnWidget *p = s->parent; p; p = p->parent)
+        if(p->isQueued && p->queueFrame == frame)
+            a = p;
+    return a;
+}
 
-    DASSERT(q);
-    DASSERT(s);
+static inline uint64_t Area(const struct PnAllocation *a) {
+    return ((uint64_t) a->width) * a->height;
+}
+
+// Is "b" inside "a"?
+static inline bool Contains(const struct PnAllocation *a,
+        const struct PnAllocation *b) {
+    return (b->x >= a->x && b->y >= a->y &&
+            b->x + b->width <= a->x + a->width &&
+            b->y + b->height <= a->y + a->height);
+}
 
-    struct PnWidget *c;
-    if(s->layout != PnLayout_Grid) {
-        for(c = s->l.firstChild; c; c = c->pl.nextSibling) {
-            // If the widget surface "c" is culled it can get un-culled at
-            // any time so we just work with it.  It could happen that
-            // things change before we get to draw.  Drawing events are
-            // somewhat asynchronous to this process.
-            if(c->isQueued)
-                RemoveFromDrawQueue(q, c);
-            else if(HaveChildren(s))
-                // If a child is not queued it could have queued children.
-                DequeueChildren(q, c);
+// Do "a" and "b" overlap or touch at an edge?
+static inline bool Touches(const struct PnAllocation *a,
+        const struct PnAllocation *b) {
+    return (b->x <= a->x + a->width && a->x <= b->x + b->width &&
+            b->y <= a->y + a->height && a->y <= b->y + b->height);
+}
+
+// Make "a" be the bounding box of "a" and "b".
+static inline void Union(struct PnAllocation *a,
+        const struct PnAllocation *b) {
+    uint32_t x1 = a->x + a->width, y1 = a->y + a->height;
+    if(b->x + b->width > x1) x1 = b->x + b->width;
+    if(b->y + b->height > y1) y1 = b->y + b->height;
+    if(b->x < a->x) a->x = b->x;
+    if(b->y < a->y) a->y = b->y;
+    a->width = x1 - a->x;
+    a->height = y1 - a->y;
+}
+
+static inline bool ShouldMerge(const struct PnAllocation *a,
+        const struct PnAllocation *b) {
+
+    if(!Touches(a, b)) return false;
+    struct PnAllocation u = *a;
+    Union(&u, b);
+    return (Area(&u) <= Area(a) + Area(b));
+}
+
+// Add a rectangle to a list of rectangles, rects, that has *num in it
+// and can have at most max.
+//
+// We merge rectangles that touch if their bounding box is not larger
+// than the two areas added together; so that's like side by side widgets,
+// or widgets that overlap a lot.  We are not trying to find the best
+// set of rectangles (that's a hard problem), just to get rid of the
+// stupid ones; like a widget inside a widget that is also drawn.
+//
+static void AddRect(struct PnAllocation *rects, uint32_t *num,
+        uint32_t max, const struct PnAllocation *a) {
+
+    if(!a->width || !a->height) return;
+
+    struct PnAllocation r = *a;
+
+again:
+
+    for(uint32_t i = 0; i < *num;) {
+        struct PnAllocation *b = rects + i;
+        if(Contains(b, &r))
+            // Already have it.
+            return;
+        if(Contains(&r, b) || ShouldMerge(b, &r)) {
+            // Remove "b" and add it to "r".
+            Union(&r, b);
+            *b = rects[--(*num)];
+            // "r" is larger now so it may take in ones we already
+            // looked at.
+            goto again;
         }
+        ++i;
+    }
+
+    if(*num < max) {
+        rects[(*num)++] = r;
         return;
     }
 
-    // else // This widget "s" is a grid container.
-    if(!s->g.grid)
-            // "s" has no children.
-            return;
-    struct PnWidget ***child = s->g.grid->child;
-    DASSERT(child);
-    for(uint32_t y=s->g.numRows-1; y != -1; --y)
-        for(uint32_t x=s->g.numColumns-1; x != -1; --x) {
-            struct PnWidget *c = child[y][x];
-            // rows and columns can share widgets; like for row span 2 and
-            // column span 2; that is adjacent cells that share the same
-            // widget.
-            if(IsUpperLeftCell(c, child, x, y)) {
-                if(c->isQueued)
-                    RemoveFromDrawQueue(q, c);
-                else if(HaveChildren(s))
-                    // If a child is not queued it could have queued children.
-                    DequeueChildren(q, c);
-            }
-        }
+    // Too many.  Use the bounding box of them all.
+    for(uint32_t i = 0; i < *num; ++i)
+        Union(&r, rects + i);
+    rects[0] = r;
+    *num = 1;
 }
 
-void pnWidget_queueDraw(struct PnWidget *s, bool allocate) {
+// Add a rectangle to the frame damage of the window.
+//
+static inline void AddFrameDamage(struct PnWindow *win,
+        const struct PnAllocation *a) {
+
+    uint32_t max = win->maxDamageRects;
+    if(!max) max = PN_DEFAULT_DAMAGE_RECTS;
+    AddRect(win->frameDamage, &win->numFrameDamage, max, a);
+}
+
+// Make "a" be the part of "a" that is in "b".  It can end up with zero
+// width or height.
+static inline void Intersect(struct PnAllocation *a,
+        const struct PnAllocation *b) {
+    uint32_t x1 = a->x + a->width, y1 = a->y + a->height;
+    if(x1 > b->x + b->width) x1 = b->x + b->width;
+    if(y1 > b->y + b->height) y1 = b->y + b->height;
+    if(a->x < b->x) a->x = b->x;
+    if(a->y < b->y) a->y = b->y;
+    a->width = (x1 > a->x) ? x1 - a->x : 0;
+    a->height = (y1 > a->y) ? y1 - a->y : 0;
+}
+
+// Queue "s" to be drawn.  If rect is not 0 it is the only part of "s"
+// that needs drawing, in window coordinates.
+//
+static void QueueDraw(struct PnWidget *s, bool allocate,
+        const struct PnAllocation *rect) {
 
     DASSERT(s);
     struct PnWindow *win = s->window;
@@ -122,6 +210,15 @@ void pnWidget_queueDraw(struct PnWidget *s, bool allocate) {
         DASSERT(win->dqWrite->first);
         DASSERT(win->dqWrite->last);
         //DASSERT(win->wl_callback);// This popped.
+        if(allocate)
+            // The caller wants more than just the children allocated.
+            s->allocateChildren = false;
+        if(!s->numDirty) return;
+        if(rect && !allocate)
+            AddRect(s->dirty, &s->numDirty, PN_MAX_DIRTY_RECTS, rect);
+        else
+            // Now it all needs drawing.
+            s->numDirty = 0;
         return;
     }
 
@@ -132,19 +229,27 @@ void pnWidget_queueDraw(struct PnWidget *s, bool allocate) {
         // draw happens.
         return;
 
+    // The rule is that if a parent (or higher parentage) of this surface
+    // it queued than so is this widget surface, "s".  If a parent surface
+    // gets drawn the children always get drawn right after.  That just
+    // how we designed this widgets inside container widgets thing.
+    struct PnWidget *a = QueuedAncestor(s, win->frame);
+    if(a) {
+        if(allocate)
+            // The ancestor will get the allocations for all of its
+            // children, "s" included.
+            a->needAllocate = true;
+        return;
+    }
+
     if(_pnWindow_addCallback(win))
         // It already spewed via ERROR().
         // Failure.  That sucks.
         return;
 
-    // The rule is that if a parent (or higher parentage) of this surface
-    // it queued than so is this widget surface, "s".
-
-    // Remove any descendants from the draw queue.  They get queued
-    // implicitly by this, "s", being queued.  If a parent surface gets
-    // drawn the children always get drawn right after.  That just how we
-    // designed this widgets inside container widgets thing.
-    DequeueChildren(win->dqWrite, s);
+    // Any descendants that are in the draw queue stay there.  They are
+    // skipped in DrawFromQueue() when they find this "s" queued above
+    // them.
 
     // Now queue this widget surface "s" at win->dqWrite->last.
     DASSERT(!s->dqNext);
@@ -165,15 +270,135 @@ void pnWidget_queueDraw(struct PnWidget *s, bool allocate) {
     DASSERT(!q->first->dqPrev);
     q->last = s;
     s->isQueued = true;
+    s->queueFrame = win->frame;
     // TODO: It may be more performant to call _pnWidget_getAllocations(s)
     // now; but we still need to wait for the compositor to tell us when
     // the wl_buffer is ready so we can re-setup the Cairo surfaces on the
     // wl_buffer (for the case when allocate == true).
 
+    // We only draw part of widgets that have no children.  Children
+    // widgets are drawn over their parents, so we'd need to redraw the
+    // children that are in the rectangles too; we don't bother.
+    s->numDirty = 0;
+    if(rect && !allocate && !HaveChildren(s)) {
+        s->dirty[0] = *rect;
+        s->numDirty = 1;
+    }
+
     if(allocate)
         s->needAllocate = allocate;
 }
 
+void pnWidget_queueDraw(struct PnWidget *s, bool allocate) {
+    // Draw callbacks can call this from worker threads.
+    LockDrawQueue();
+    QueueDraw(s, allocate, 0);
+    UnlockDrawQueue();
+}
+
+// Queue "s" to be drawn after redoing the allocations of just its
+// children.  The allocation of "s" does not change.  See RelayoutChanged()
+// in allocation.c.
+//
+void QueueAllocateChildren(struct PnWidget *s) {
+
+    DASSERT(s);
+    DASSERT(s->parent);
+
+    LockDrawQueue();
+
+    if(s->isQueued) {
+        if(!s->needAllocate) {
+            s->needAllocate = true;
+            s->allocateChildren = true;
+        }
+        // All of it needs drawing now.
+        s->numDirty = 0;
+    } else {
+        QueueDraw(s, true, 0);
+        if(s->isQueued)
+            s->allocateChildren = true;
+    }
+
+    UnlockDrawQueue();
+}
+
+// Queue just a rectangle of the widget, "s", to be drawn.  x, y are
+// relative to the window, like in struct PnAllocation.  The rectangles
+// from more calls before the draw are added together.
+//
+// The widget's cairoDraw callback gets a cairo clip of the rectangles,
+// and the draw callback can get them with pnWidget_getDirtyRects().
+// Only the rectangles are damaged (sent to the compositor as changed).
+//
+void pnWidget_queueDrawRect(struct PnWidget *s,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+
+    DASSERT(s);
+
+    struct PnAllocation r = { x, y, width, height };
+    Intersect(&r, &s->allocation);
+    if(!r.width || !r.height)
+        // It's not in the widget.
+        return;
+
+    LockDrawQueue();
+    QueueDraw(s, false, &r);
+    UnlockDrawQueue();
+}
+
+// Get the rectangles of the widget that need drawing, in window
+// coordinates.  Returns the number of them, or 0 if the whole widget
+// needs drawing.  This is for use in the draw callback.
+//
+uint32_t pnWidget_getDirtyRects(const struct PnWidget *s,
+        const struct PnAllocation **rects) {
+
+    DASSERT(s);
+    DASSERT(rects);
+
+    *rects = s->dirty;
+    return s->numDirty;
+}
+
+// Send the frame damage to the compositor (and the swapchain buffers).
+//
+static inline void FlushFrameDamage(struct PnWindow *win) {
+
+    for(uint32_t i = 0; i < win->numFrameDamage; ++i) {
+        struct PnAllocation *a = win->frameDamage + i;
+        win->damagedPixels += Area(a);
+        DamageBuffer(win, a->x, a->y, a->width, a->height);
+    }
+    win->numFrameDamage = 0;
+}
+
+// After "s" is drawn from the queue.  dirty[] is a copy of the dirty
+// rectangles that "s" had when it was drawn.
+//
+static inline void FinishDraw(struct PnWindow *win, struct PnWidget *s,
+        struct PnAllocation *dirty, uint32_t numDirty) {
+
+    s->needAllocate = false;
+    s->allocateChildren = false;
+    // The draw() function may have queued that surface again
+    // but in the write (other) queue now.
+    if(!s->isQueued)
+        s->numDirty = 0;
+
+    // Looks like we can add together rectangles of damage.
+    if(numDirty) {
+        for(uint32_t i = 0; i < numDirty; ++i) {
+            Intersect(dirty + i, &s->allocation);
+            win->drawnPixels += Area(dirty + i);
+            AddFrameDamage(win, dirty + i);
+        }
+    } else {
+        win->drawnPixels += Area(&s->allocation);
+        AddFrameDamage(win, &s->allocation);
+    }
+}
+
 // Return false if the queue was drawn.
 //
 // Return true is the buffer was busy so we did not draw.
@@ -184,14 +409,20 @@ bool DrawFromQueue(struct PnWindow *win) {
     DASSERT(win->dqWrite);
     DASSERT(win->dqWrite->first);
     DASSERT(win->dqWrite->last);
-    DASSERT(!win->widget.needAllocate);
+    // The window widget can get needAllocate from a child that was
+    // queued with allocate after the window was queued.
+    DASSERT(!win->widget.needAllocate || win->widget.isQueued);
     DASSERT(!win->needDraw);
 
     struct PnBuffer *buffer = GetNextBuffer(win,
             win->widget.allocation.width,
             win->widget.allocation.height);
 
-    DASSERT(buffer);
+    if(!buffer)
+        // All the swapchain buffers are busy, or we failed to make a
+        // buffer.  We keep the queue and try again later.
+        return true;
+
     DASSERT(win->widget.allocation.width == buffer->width);
     DASSERT(win->widget.allocation.height == buffer->height);
 
@@ -202,22 +433,51 @@ bool DrawFromQueue(struct PnWindow *win) {
     win->dqWrite = win->dqRead;
     DASSERT(win->dqWrite != q);
     win->dqRead = q;
+    // Widgets queued from now on are in the next frame.
+    uint32_t frame = win->frame++;
     // Dequeue the old write queue, which this now the read queue, q.
 
     // Note: we call it the "read" queue but we are reading and dequeueing
     // (writing) it here.  It's more like reading what to draw, so ya,
     // read.
     struct PnWidget *s;
+    // For the frame statistics.
+    uint64_t layout = 0, draw = 0, t;
+    uint64_t damagedPixels = win->damagedPixels;
 
     while((s = PopQueue(q))) {
 
+        struct PnWidget *a = QueuedAncestor(s, frame);
+        if(a) {
+            // "a" is later in this queue and it will draw "s".
+            if(s->needAllocate) {
+                a->needAllocate = true;
+                s->needAllocate = false;
+                s->allocateChildren = false;
+            }
+            s->numDirty = 0;
+            continue;
+        }
+
+        if(s->needAllocate || HaveChildren(s))
+            // Draw all of it.
+            s->numDirty = 0;
+
+        // We keep a copy of the dirty rectangles, because the draw
+        // callback may queue "s" again with new ones.
+        struct PnAllocation dirty[PN_MAX_DIRTY_RECTS];
+        uint32_t numDirty = s->numDirty;
+        if(numDirty)
+            memcpy(dirty, s->dirty, numDirty*sizeof(*dirty));
+
         if(s->needAllocate) {
             // TODO: maybe call _pnWidget_getAllocations()
             // in pnWidget_queueDraw()?
             //
             // TODO: add config() callbacks....
 
-            if(s->parent)
+            t = FrameClock();
+            if(s->parent && !s->allocateChildren)
                 // The things calculated in _pnWidget_getAllocations() are
                 // values in the children of the passed argument widget,
                 // so we pass in the parent widget to get the new sizes
@@ -229,25 +489,51 @@ bool DrawFromQueue(struct PnWindow *win) {
 #ifdef WITH_CAIRO
             RecreateCairos(win, s);
 #endif
+            layout += FrameClock() - t;
         }
 
-        pnSurface_draw(s, buffer, s->needAllocate);
+        if(d.drawWorkers) {
+            // We draw it below with the others, in parallel.
+            AddDrawItem(s, dirty, numDirty);
+            continue;
+        }
+
+        t = FrameClock();
+        win->widgetsDrawn += pnSurface_draw(s, buffer, s->needAllocate);
+        draw += FrameClock() - t;
 
-        s->needAllocate = false;
-        // The draw() function may have queued that surface again
-        // but in the write (other) queue now.
-        //
-        // Looks like we can add together rectangles of damage.
-        d.surface_damage_func(win->wl_surface,
-                s->allocation.x, s->allocation.y,
-                s->allocation.width, s->allocation.height);
+        FinishDraw(win, s, dirty, numDirty);
      }
 
     // The "read" queue should be empty now.
     DASSERT(!q->last);
 
-    wl_surface_attach(win->wl_surface, buffer->wl_buffer, 0, 0);
-    wl_surface_commit(win->wl_surface);
+    if(d.drawWorkers) {
+        uint32_t n;
+        t = FrameClock();
+        // This returns after all the widgets are drawn.
+        struct PnDrawItem *items = DrawItems(buffer, &n);
+        draw += FrameClock() - t;
+
+        for(uint32_t i = 0; i < n; ++i) {
+            win->widgetsDrawn += items[i].widgets;
+            FinishDraw(win, items[i].widget,
+                    items[i].dirty, items[i].numDirty);
+        }
+    }
+
+    t = FrameClock();
+
+    FlushFrameDamage(win);
+
+    if(!d.headless) {
+        wl_surface_attach(win->wl_surface, GetAttachBuffer(win), 0, 0);
+        AddFeedback(win);
+        wl_surface_commit(win->wl_surface);
+    }
+
+    AddFrameRecord(win, layout, draw, t,
+            win->damagedPixels - damagedPixels);
 
     return false;
 }
@@ -279,4 +565,7 @@ void FlushDrawQueue(struct PnWindow *win) {
         wl_callback_destroy(win->wl_callback);
         win->wl_callback = 0;
     }
+    win->headlessFrame = false;
+    // Nothing is queued for the frame pacing timer to draw now.
+    win->pacingPending = false;
 }
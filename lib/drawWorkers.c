@@ -0,0 +1,282 @@
+// Optional worker threads that draw the widgets in a window's draw queue
+// in parallel.
+//
+// Widgets draw to their own rectangles of the same shared memory pixel
+// buffer, and each widget has its own cairo_t, so widgets that do not
+// overlap can be drawn at the same time.  DrawFromQueue() does the
+// allocations (layout) for the queued widgets first, in the main thread,
+// and then gives them all to DrawItems() which draws them in batches of
+// widgets that do not overlap.  Widgets that overlap (like a child that
+// is queued after its parent) are drawn in the order that they were
+// queued, in a later batch.  DrawItems() returns after all are drawn, so
+// all the drawing is done before the wl_surface_commit().
+//
+// This is off by default.  Turn it on with pnDisplay_setDrawThreads().
+// With it on, the widget draw callbacks must be okay with being called
+// at the same time as the draw callbacks of other widgets, and they
+// should only queue draws of their own widget.
+//
+// The main thread draws too, so with N threads we make N-1 worker
+// threads.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#include "../include/panels.h"
+#include "debug.h"
+#include "display.h"
+
+
+struct PnDrawWorkers {
+
+    pthread_t *threads;
+    uint32_t numThreads;
+
+    pthread_mutex_t mutex;
+    // Workers wait on this for a batch of widgets to draw.
+    pthread_cond_t cond;
+    // The main thread waits on this for the batch to finish.
+    pthread_cond_t doneCond;
+
+    // Locks the draw queue from draw callbacks while we are drawing.
+    pthread_mutex_t queueMutex;
+    bool running;
+
+    // All the queued widgets we are drawing in this frame.
+    struct PnDrawItem *items;
+    uint32_t numItems, maxItems;
+
+    // The current batch of widgets being drawn.
+    struct PnDrawItem **batch;
+    uint32_t batchSize, next, done;
+    const struct PnBuffer *buffer;
+
+    bool quit;
+};
+
+
+void LockDrawQueue(void) {
+    if(d.drawWorkers && d.drawWorkers->running)
+        pthread_mutex_lock(&d.drawWorkers->queueMutex);
+}
+
+void UnlockDrawQueue(void) {
+    if(d.drawWorkers && d.drawWorkers->running)
+        pthread_mutex_unlock(&d.drawWorkers->queueMutex);
+}
+
+
+// Draw items from the current batch until there are none left.  Call
+// with the w->mutex locked; it's locked again when this returns.
+//
+static void DrawBatch(struct PnDrawWorkers *w) {
+
+    while(w->next < w->batchSize) {
+        struct PnDrawItem *item = w->batch[w->next++];
+        const struct PnBuffer *buffer = w->buffer;
+
+        pthread_mutex_unlock(&w->mutex);
+        item->widgets = pnSurface_draw(item->widget, buffer,
+                item->widget->needAllocate);
+        pthread_mutex_lock(&w->mutex);
+
+        if(++w->done == w->batchSize)
+            pthread_cond_signal(&w->doneCond);
+    }
+}
+
+static void *Worker(struct PnDrawWorkers *w) {
+
+    pthread_mutex_lock(&w->mutex);
+
+    while(true) {
+        while(!w->quit && w->next >= w->batchSize)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        if(w->quit) break;
+        DrawBatch(w);
+    }
+
+    pthread_mutex_unlock(&w->mutex);
+    return 0;
+}
+
+
+void AddDrawItem(struct PnWidget *s,
+        const struct PnAllocation *dirty, uint32_t numDirty) {
+
+    struct PnDrawWorkers *w = d.drawWorkers;
+    DASSERT(w);
+    DASSERT(numDirty <= PN_MAX_DIRTY_RECTS);
+
+    if(w->numItems == w->maxItems) {
+        w->maxItems += 16;
+        w->items = realloc(w->items, w->maxItems*sizeof(*w->items));
+        ASSERT(w->items, "realloc(,%zu) failed",
+                w->maxItems*sizeof(*w->items));
+        w->batch = realloc(w->batch, w->maxItems*sizeof(*w->batch));
+        ASSERT(w->batch, "realloc(,%zu) failed",
+                w->maxItems*sizeof(*w->batch));
+    }
+
+    struct PnDrawItem *item = w->items + w->numItems++;
+    item->widget = s;
+    item->numDirty = numDirty;
+    if(numDirty)
+        memcpy(item->dirty, dirty, numDirty*sizeof(*dirty));
+    item->widgets = 0;
+}
+
+
+// Do "a" and "b" share any pixels?
+static inline bool Overlaps(const struct PnAllocation *a,
+        const struct PnAllocation *b) {
+    return (b->x < a->x + a->width && a->x < b->x + b->width &&
+            b->y < a->y + a->height && a->y < b->y + b->height);
+}
+
+
+// Draw all the items added with AddDrawItem() and return them, and the
+// number of them in *num.  The returned array is good until the next
+// AddDrawItem().
+//
+struct PnDrawItem *DrawItems(const struct PnBuffer *buffer,
+        uint32_t *num) {
+
+    struct PnDrawWorkers *w = d.drawWorkers;
+    DASSERT(w);
+    DASSERT(num);
+
+    struct PnDrawItem *items = w->items;
+    uint32_t n = w->numItems;
+    uint32_t numBatches = 0;
+
+    // An item goes in the batch after the last batch of the items
+    // before it that it overlaps.  That keeps the queue order for
+    // widgets that overlap.  There are not many items, so O(n*n) is
+    // fine.
+    for(uint32_t i = 0; i < n; ++i) {
+        uint32_t b = 0;
+        for(uint32_t j = 0; j < i; ++j)
+            if(items[j].batch >= b && Overlaps(&items[i].widget->allocation,
+                        &items[j].widget->allocation))
+                b = items[j].batch + 1;
+        items[i].batch = b;
+        if(b + 1 > numBatches)
+            numBatches = b + 1;
+    }
+
+    pthread_mutex_lock(&w->mutex);
+    w->running = true;
+    w->buffer = buffer;
+
+    for(uint32_t b = 0; b < numBatches; ++b) {
+
+        w->batchSize = 0;
+        w->next = 0;
+        w->done = 0;
+        for(uint32_t i = 0; i < n; ++i)
+            if(items[i].batch == b)
+                w->batch[w->batchSize++] = items + i;
+        DASSERT(w->batchSize);
+
+        if(w->batchSize > 1)
+            pthread_cond_broadcast(&w->cond);
+
+        // This thread draws too.
+        DrawBatch(w);
+
+        while(w->done < w->batchSize)
+            pthread_cond_wait(&w->doneCond, &w->mutex);
+    }
+
+    w->batchSize = 0;
+    w->next = 0;
+    w->running = false;
+    pthread_mutex_unlock(&w->mutex);
+
+    w->numItems = 0;
+    *num = n;
+    return items;
+}
+
+
+void DestroyDrawWorkers(void) {
+
+    struct PnDrawWorkers *w = d.drawWorkers;
+    if(!w) return;
+
+    pthread_mutex_lock(&w->mutex);
+    w->quit = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+
+    for(uint32_t i = 0; i < w->numThreads; ++i)
+        pthread_join(w->threads[i], 0);
+
+    pthread_mutex_destroy(&w->queueMutex);
+    pthread_cond_destroy(&w->doneCond);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+
+    if(w->items) {
+        DZMEM(w->items, w->maxItems*sizeof(*w->items));
+        free(w->items);
+        free(w->batch);
+    }
+    if(w->threads)
+        free(w->threads);
+
+    DZMEM(w, sizeof(*w));
+    free(w);
+    d.drawWorkers = 0;
+}
+
+
+// Draw the queued widgets of windows with num threads, counting this
+// (the main) thread.  num < 2 turns it off, the default.
+//
+// Do not call this from a draw callback.
+//
+void pnDisplay_setDrawThreads(uint32_t num) {
+
+    if(!HaveDisplay() && _pnDisplay_create()) {
+        DASSERT(0);
+        return;
+    }
+
+    DestroyDrawWorkers();
+
+    if(num < 2) return;
+
+    struct PnDrawWorkers *w = calloc(1, sizeof(*w));
+    ASSERT(w, "calloc(1,%zu) failed", sizeof(*w));
+
+    pthread_mutex_init(&w->mutex, 0);
+    pthread_cond_init(&w->cond, 0);
+    pthread_cond_init(&w->doneCond, 0);
+    pthread_mutex_init(&w->queueMutex, 0);
+
+    w->threads = calloc(num - 1, sizeof(*w->threads));
+    ASSERT(w->threads, "calloc(%" PRIu32 ",%zu) failed",
+            num - 1, sizeof(*w->threads));
+
+    d.drawWorkers = w;
+
+    for(; w->numThreads < num - 1; ++w->numThreads)
+        if(pthread_create(w->threads + w->numThreads, 0,
+                    (void *(*)(void *)) Worker, w)) {
+            ERROR("pthread_create() failed");
+            break;
+        }
+
+    if(!w->numThreads) {
+        // We can't have just the main thread.
+        DestroyDrawWorkers();
+        return;
+    }
+
+    DSPEW("Drawing with %" PRIu32 " threads", w->numThreads + 1);
+}
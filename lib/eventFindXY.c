@@ -15,14 +15,10 @@
 // Find the most childish surface (widget) that has the mouse pointer
 // position, x and y, in it.
 //
-// TODO: Do we need a faster surface search data structure?  Yes.  We
-// should make the searching of lists converge with O(logN) (base 2),
-// using an interaction that is bisecting the iterator.  Halving the
-// search pool at each iteration step.  PnLayout_Grid does this, but other
-// layouts do not.  Also, I think there are even faster way than that...
-//
-// TODO: Maybe the widget (surface) order in the searching could be more
-// optimal.
+// This searches the widget tree from "s" down, and it's slow for
+// containers with lots of children; so FindWidget() (below) uses it
+// only to search down from the bins of the window's find index, when
+// x,y is not in a leaf widget.
 //
 static
 struct PnWidget *FindSurface(const struct PnWindow *win,
@@ -229,6 +225,236 @@ struct PnWidget *FindSurface(const struct PnWindow *win,
 }
 
 
+// The window find index.
+//
+// We cut the window into a uniform grid of square bins, and list in each
+// bin the leaf widgets (widgets with no children) that share pixels with
+// it.  Leaf widgets do not overlap, and the window's widgets are nearly
+// all leaves, so finding the widget at x,y is just a look at the few
+// leaves in one bin.  If x,y is in none of them it's in the border of a
+// container (or a container with all its children culled), and we use
+// FindSurface() from the most childish widget that has all of the bin
+// in it.  We pick the bin size so there are about two leaves per bin.
+//
+// We rebuild it, at the next find, after the allocations change; see
+// InvalidateFindIndex().  Rebuilding is O(N) for N widgets, and most
+// frames that do the allocations do not get a pointer event before the
+// next frame, so we just rebuild it when we need it.
+
+
+static uint32_t CountLeaves(const struct PnWidget *s) {
+
+    if(s->culled) return 0;
+    if(!HaveChildren(s)) return 1;
+
+    uint32_t num = 0;
+
+    if(s->layout != PnLayout_Grid) {
+        for(struct PnWidget *c = s->l.firstChild; c;
+                c = c->pl.nextSibling)
+            num += CountLeaves(c);
+        return num;
+    }
+
+    struct PnWidget ***child = s->g.grid->child;
+    for(uint32_t y = 0; y < s->g.numRows; ++y)
+        for(uint32_t x = 0; x < s->g.numColumns; ++x)
+            if(IsUpperLeftCell(child[y][x], child, x, y))
+                num += CountLeaves(child[y][x]);
+    return num;
+}
+
+
+// Add widget "s" and its children to the find index "f".  With "count"
+// set we just count the leaves in each bin in f->start[i+1] and set the
+// bin owners, else we add the leaves to f->leaves[] using f->start[i]
+// as the next place in bin i.
+//
+static void AddToIndex(struct PnFindIndex *f, struct PnWidget *s,
+        uint32_t width, uint32_t height, bool count) {
+
+    if(s->culled) return;
+
+    const struct PnAllocation *a = &s->allocation;
+    if(!a->width || !a->height ||
+            a->x >= width || a->y >= height) return;
+
+    uint32_t shift = f->shift;
+    uint32_t numX = f->numX;
+
+    if(!HaveChildren(s)) {
+        uint32_t x0 = a->x >> shift;
+        uint32_t x1 = (a->x + a->width - 1) >> shift;
+        uint32_t y1 = (a->y + a->height - 1) >> shift;
+        // I don't think widgets get allocated past the window edges,
+        // but just in case.
+        if(x1 >= numX) x1 = numX - 1;
+        if(y1 >= f->numY) y1 = f->numY - 1;
+        for(uint32_t y = a->y >> shift; y <= y1; ++y)
+            for(uint32_t x = x0; x <= x1; ++x) {
+                uint32_t i = y * numX + x;
+                if(count)
+                    ++f->start[i+1];
+                else
+                    f->leaves[f->start[i]++] = s;
+            }
+        return;
+    }
+
+    if(count) {
+        // The bins that are all in "s".  The bins at the right and
+        // bottom edges of the window hang off the window, so they are
+        // all in "s" if "s" goes to the edge.  We set the owners of the
+        // children after this, so the most childish widget wins.
+        uint32_t size = 1 << shift;
+        uint32_t x0 = (a->x + size - 1) >> shift;
+        uint32_t y0 = (a->y + size - 1) >> shift;
+        uint32_t x1 = (a->x + a->width >= width) ?
+                numX : (a->x + a->width) >> shift;
+        uint32_t y1 = (a->y + a->height >= height) ?
+                f->numY : (a->y + a->height) >> shift;
+        for(uint32_t y = y0; y < y1; ++y)
+            for(uint32_t x = x0; x < x1; ++x)
+                f->owner[y * numX + x] = s;
+    }
+
+    if(s->layout != PnLayout_Grid) {
+        for(struct PnWidget *c = s->l.firstChild; c;
+                c = c->pl.nextSibling)
+            AddToIndex(f, c, width, height, count);
+        return;
+    }
+
+    struct PnWidget ***child = s->g.grid->child;
+    for(uint32_t y = 0; y < s->g.numRows; ++y)
+        for(uint32_t x = 0; x < s->g.numColumns; ++x)
+            if(IsUpperLeftCell(child[y][x], child, x, y))
+                AddToIndex(f, child[y][x], width, height, count);
+}
+
+
+static void BuildIndex(struct PnWindow *win) {
+
+    struct PnFindIndex *f = &win->findIndex;
+    uint32_t width = win->widget.allocation.width;
+    uint32_t height = win->widget.allocation.height;
+    DASSERT(width && height);
+
+    // Pick the bin size so that there are about two leaves per bin.
+    uint32_t maxBins = CountLeaves(&win->widget)/2 + 1;
+    if(maxBins > PN_FIND_MAX_BINS)
+        maxBins = PN_FIND_MAX_BINS;
+    f->shift = 0;
+    while(((uint64_t) ((width - 1) >> f->shift) + 1) *
+            (((height - 1) >> f->shift) + 1) > maxBins)
+        ++f->shift;
+    f->numX = ((width - 1) >> f->shift) + 1;
+    f->numY = ((height - 1) >> f->shift) + 1;
+    uint32_t numBins = f->numX * f->numY;
+
+    if(numBins > f->maxBins) {
+        f->maxBins = numBins;
+        f->start = realloc(f->start, (numBins + 1)*sizeof(*f->start));
+        ASSERT(f->start, "realloc(,%zu) failed",
+                (numBins + 1)*sizeof(*f->start));
+        f->owner = realloc(f->owner, numBins*sizeof(*f->owner));
+        ASSERT(f->owner, "realloc(,%zu) failed",
+                numBins*sizeof(*f->owner));
+    }
+    memset(f->start, 0, (numBins + 1)*sizeof(*f->start));
+    memset(f->owner, 0, numBins*sizeof(*f->owner));
+
+    AddToIndex(f, &win->widget, width, height, true);
+
+    // Now f->start[i+1] is the number of leaves in bin i.  Make it the
+    // index of the first leaf in bin i+1.
+    for(uint32_t i = 1; i <= numBins; ++i)
+        f->start[i] += f->start[i-1];
+    f->numLeaves = f->start[numBins];
+
+    if(f->numLeaves > f->maxLeaves) {
+        f->maxLeaves = f->numLeaves + f->numLeaves/4;
+        f->leaves = realloc(f->leaves,
+                f->maxLeaves*sizeof(*f->leaves));
+        ASSERT(f->leaves, "realloc(,%zu) failed",
+                f->maxLeaves*sizeof(*f->leaves));
+    }
+
+    AddToIndex(f, &win->widget, width, height, false);
+
+    // Adding the leaves moved f->start[i] to where f->start[i+1] was.
+    // Move them back.
+    memmove(f->start + 1, f->start, numBins*sizeof(*f->start));
+    f->start[0] = 0;
+    DASSERT(f->start[numBins] == f->numLeaves);
+
+    f->valid = true;
+}
+
+
+void FreeFindIndex(struct PnWindow *win) {
+
+    struct PnFindIndex *f = &win->findIndex;
+
+    if(f->start) {
+        DZMEM(f->start, (f->maxBins + 1)*sizeof(*f->start));
+        free(f->start);
+        DZMEM(f->owner, f->maxBins*sizeof(*f->owner));
+        free(f->owner);
+    }
+    if(f->leaves) {
+        DZMEM(f->leaves, f->maxLeaves*sizeof(*f->leaves));
+        free(f->leaves);
+    }
+    memset(f, 0, sizeof(*f));
+}
+
+
+// Find the most childish widget that has x,y in it, like FindSurface()
+// from the window, but using the window's find index.  x,y must be in
+// the window.
+//
+static
+struct PnWidget *FindWidget(struct PnWindow *win, uint32_t x, uint32_t y) {
+
+    DASSERT(x < win->widget.allocation.width);
+    DASSERT(y < win->widget.allocation.height);
+
+    struct PnFindIndex *f = &win->findIndex;
+    if(!f->valid)
+        BuildIndex(win);
+
+    uint32_t i = (y >> f->shift) * f->numX + (x >> f->shift);
+    DASSERT(i < f->numX * f->numY);
+
+    struct PnWidget **l = f->leaves + f->start[i];
+    struct PnWidget **end = f->leaves + f->start[i+1];
+    for(; l < end; ++l)
+        if(pnWidget_isInSurface(*l, x, y))
+            return *l;
+
+    // x,y is not in a leaf widget.
+    return FindSurface(win, f->owner[i] ? f->owner[i] : &win->widget,
+            x, y);
+}
+
+
+struct PnWidget *pnWindow_getWidgetAt(const struct PnWidget *w,
+        int32_t x, int32_t y) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+
+    if(x < 0 || y < 0 ||
+            (uint32_t) x >= w->allocation.width ||
+            (uint32_t) y >= w->allocation.height)
+        // This includes the window not being allocated yet.
+        return 0;
+
+    return FindWidget((void *) w, x, y);
+}
+
+
 void GetPointerSurface(void) {
 
     DASSERT(d.pointerWindow);
@@ -246,15 +472,9 @@ void GetPointerSurface(void) {
             d.y < d.pointerWidget->allocation.y + 
                     d.pointerWidget->allocation.height;
 
-    if(inPointerWidget) {
-        // Lets start with the mouse pointer is at the same widget.
-        if(HaveChildren(d.pointerWidget))
-            d.pointerWidget = FindSurface(d.pointerWindow, d.pointerWidget,
-                    d.x, d.y);
-        // else it's already at the most childish widget under the
-        // pointer.
+    if(inPointerWidget && !HaveChildren(d.pointerWidget))
+        // It's still at the most childish widget under the pointer.
         return;
-    }
 
     if(d.x < 0 || d.y < 0 ||
             d.x >= d.pointerWindow->widget.allocation.width ||
@@ -271,9 +491,7 @@ void GetPointerSurface(void) {
         return;
     }
 
-    // It moved out from where it was. Start at the window surface.
-    d.pointerWidget = FindSurface(d.pointerWindow,
-            (void *) d.pointerWindow, d.x, d.y);
+    d.pointerWidget = FindWidget(d.pointerWindow, d.x, d.y);
 }
 
 
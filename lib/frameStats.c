@@ -0,0 +1,137 @@
+// Per window frame statistics.
+//
+// For each frame that we draw we record how long the layout, the widget
+// drawing, and the commit took, how many widgets were drawn, and how
+// many pixels we told the compositor changed.  We keep the last
+// PN_FRAME_STATS frames in a ring in the window, and
+// pnWindow_getFrameStats() makes percentiles from them.
+//
+// Getting the time costs about as much as a function call (clock_gettime()
+// does not make a system call on Linux), so we always do it.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#include "../include/panels.h"
+#include "debug.h"
+#include "display.h"
+
+
+static inline uint32_t Clip32(uint64_t x) {
+    return (x > UINT32_MAX) ? UINT32_MAX : x;
+}
+
+
+// Called just after the wl_surface_commit() of a frame.  commitStart is
+// the FrameClock() time after the widgets were drawn.
+//
+void AddFrameRecord(struct PnWindow *win, uint64_t layout,
+        uint64_t draw, uint64_t commitStart, uint64_t damagedPixels) {
+
+    DASSERT(win);
+
+    struct PnFrameRecord *r = win->frameStats +
+            win->numFrames % PN_FRAME_STATS;
+
+    r->commitTime = FrameClock();
+    r->layout = Clip32(layout);
+    r->draw = Clip32(draw);
+    r->commit = Clip32(r->commitTime - commitStart);
+    r->latency = 0;
+    r->widgets = win->widgetsDrawn;
+    r->damagedPixels = Clip32(damagedPixels);
+
+    win->widgetsDrawn = 0;
+    ++win->numFrames;
+}
+
+
+// Set the time, t, that frame number "frame" was shown, if we still
+// have that frame in the ring.
+//
+void SetFrameLatency(struct PnWindow *win, uint64_t frame, uint64_t t) {
+
+    DASSERT(win);
+
+    if(frame >= win->numFrames ||
+            win->numFrames - frame > PN_FRAME_STATS)
+        return;
+
+    struct PnFrameRecord *r = win->frameStats + frame % PN_FRAME_STATS;
+
+    if(r->latency || t <= r->commitTime) return;
+    r->latency = Clip32(t - r->commitTime);
+}
+
+
+static int Compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+// Get the percentiles of the n values in x.  x gets sorted.
+//
+static void Summarize(uint32_t *x, uint32_t n, struct PnStatSummary *s) {
+
+    if(!n) {
+        memset(s, 0, sizeof(*s));
+        return;
+    }
+
+    qsort(x, n, sizeof(*x), Compare);
+
+    // Nearest rank percentiles.
+    s->p50 = x[(n * 50 - 1)/100];
+    s->p90 = x[(n * 90 - 1)/100];
+    s->p99 = x[(n * 99 - 1)/100];
+    s->max = x[n - 1];
+}
+
+
+// Gets the percentiles of the last frames that the window drew, up to
+// PN_FRAME_STATS frames.
+//
+void pnWindow_getFrameStats(const struct PnWidget *w,
+        struct PnFrameStats *stats) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    ASSERT(stats);
+    const struct PnWindow *win = (const void *) w;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->numFrames = win->numFrames;
+
+    uint32_t n = (win->numFrames < PN_FRAME_STATS) ?
+            win->numFrames : PN_FRAME_STATS;
+    stats->numSamples = n;
+    if(!n) return;
+
+    uint32_t x[PN_FRAME_STATS];
+    const struct PnFrameRecord *r = win->frameStats;
+    uint32_t i, m;
+
+#define SUMMARIZE(field)                                   \
+    do {                                                   \
+        for(i = 0; i < n; ++i)                             \
+            x[i] = r[i].field;                             \
+        Summarize(x, n, &stats->field);                    \
+    } while(0)
+
+    SUMMARIZE(layout);
+    SUMMARIZE(draw);
+    SUMMARIZE(commit);
+    SUMMARIZE(widgets);
+    SUMMARIZE(damagedPixels);
+
+#undef SUMMARIZE
+
+    // Some frames do not get a latency.
+    for(i = 0, m = 0; i < n; ++i)
+        if(r[i].latency)
+            x[m++] = r[i].latency;
+    Summarize(x, m, &stats->latency);
+}
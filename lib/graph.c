@@ -1104,6 +1104,10 @@ static int cairoDraw(struct PnWidget *w, cairo_t *cr,
         g->beamReset = true;
     }
 
+    // A phosphor scope plot paints all the graph pixels, so it goes
+    // first and the other scope plots are drawn on top of it.
+    pnWidget_callAction(&g->widget, PN_GRAPH_CB_SCOPE_PHOSPHOR);
+
     // This checks that there are userCallbacks for PN_GRAPH_CB_SCOPE_DRAW
     // set and only then calls them.
     pnWidget_callAction(&g->widget, PN_GRAPH_CB_SCOPE_DRAW);
@@ -1215,6 +1219,10 @@ struct PnWidget *pnGraph_create(struct PnWidget *parent,
             (void *) ScopeBeamDrawAction, AddScopeBeamPlot, 0/*actionData*/,
             sizeof(struct PnScopePlot));
 
+    pnWidget_addAction(&g->widget, PN_GRAPH_CB_SCOPE_PHOSPHOR,
+            (void *) ScopePhosphorDrawAction, AddScopePhosphorPlot,
+            0/*actionData*/, sizeof(struct PnScopePlot));
+
 
     // floating point scaled size exposed pixels without the padX and
     // padY added (not in number of pixels):
@@ -102,7 +102,7 @@ struct PnGraphSurface {
 };
 
 
-struct PnBeamPoint; // plot.h
+struct PnBeamPixel; // plot.h
 
 
 // A 2D plotter has a lot of parameters.  This "graph" thingy is just the
@@ -179,11 +179,21 @@ struct PnGraph {
     struct PnZoom *zoom; // current zoom level
 
     // For optional fading beam plots.
-    // An allocated array of beamPoints[width * y + x].
+    // An allocated array of beamPixels[width * y + x].  See plot.h.
     //
-    struct PnBeamPoint *beamPoints;
-    uint32_t beamPoints_width, beamPoints_height;
+    struct PnBeamPixel *beamPixels;
+    uint32_t beamPixels_width, beamPixels_height;
+    // The last stamp given to a drawn beam point.
+    uint32_t beamStamp;
     bool beamReset;
+    // A reset of the beams (when the graph background is drawn over them)
+    // does not clear beamPixels.  It just marks all the stamps made
+    // before it, up to beamResetStamp, as no good.  We clear those stale
+    // stamps from beamPixels a little at a time after that (from pixel
+    // beamSweep), while beamSweeping is set, so that the stamps can
+    // wrap around.  See BeamStampValid().
+    uint32_t beamResetStamp, beamSweep;
+    bool beamSweeping;
 
     // Plotted X and Y values on the edges of the drawing area.
     //
@@ -242,6 +252,46 @@ struct PnGraph {
 
 
 
+// Is the beam pixel stamp for a beam point that is still good, that is
+// not 0 and not made before the last beam reset?
+//
+static inline bool BeamStampValid(const struct PnGraph *g, uint32_t stamp) {
+
+    if(!stamp) return false;
+    if(!g->beamSweeping)
+        // There are no stale stamps.
+        return true;
+    // It's good if it was made after the reset.  This works as the stamps
+    // wrap, so long as we finish the sweep before beamStamp gets around
+    // to the stale stamps again.
+    return (stamp - g->beamResetStamp - 1) <
+        (g->beamStamp - g->beamResetStamp);
+}
+
+
+// Returns the color that is "w" parts in 256 toColor and the rest
+// fromColor.  0 <= w <= 256.
+//
+// Color is 32 bit in the order Alpha Red Green Blue one byte each.  We
+// blend two bytes at a time, in the even bytes and the odd bytes; each
+// product fits in the 16 bits that the byte and the zero byte above it
+// make.
+//
+static inline
+uint32_t Blend(uint32_t toColor, uint32_t fromColor, uint32_t w) {
+
+    DASSERT(w <= 256);
+    uint32_t v = 256 - w;
+
+    uint32_t rb = (((toColor & 0x00FF00FF) * w +
+                (fromColor & 0x00FF00FF) * v) >> 8) & 0x00FF00FF;
+    uint32_t ag = (((toColor >> 8) & 0x00FF00FF) * w +
+                ((fromColor >> 8) & 0x00FF00FF) * v) & 0xFF00FF00;
+
+    return ag | rb;
+}
+
+
 extern bool _pnGraph_pushZoom(struct PnGraph *g,
         double xMin, double xMax, double yMin, double yMax);
 extern bool _pnGraph_popZoom(struct PnGraph *g);
@@ -283,6 +333,13 @@ extern bool StaticDrawAction(struct PnGraph *p,
                 double xMin, double xMax, double yMin, double yMax),
         void *userData, uint32_t actionIndex, void *actionData);
 
+// Read the plot's sample ring, if it has one, before and after calling
+// the plotter callback.
+extern void PlotRingBegin(struct PnPlot *p);
+extern void PlotRingEnd(struct PnPlot *p);
+
+extern void FadeBeam(struct PnPlot *p);
+
 extern void AddScopePlot(struct PnWidget *w,
         struct PnCallback *callback, uint32_t actionIndex,
         void *actionData, void *addData);
@@ -304,3 +361,14 @@ extern bool ScopeBeamDrawAction(struct PnGraph *p,
                 struct PnPlot *plot, void *userData,
                 double xMin, double xMax, double yMin, double yMax),
         void *userData, uint32_t actionIndex, void *actionData);
+
+extern void AddScopePhosphorPlot(struct PnWidget *w,
+        struct PnCallback *callback, uint32_t actionIndex,
+        void *actionData, void *addData);
+
+extern bool ScopePhosphorDrawAction(struct PnGraph *p,
+        struct PnCallback *callback,
+        bool (*userCallback)(struct PnWidget *graph,
+                struct PnPlot *plot, void *userData,
+                double xMin, double xMax, double yMin, double yMax),
+        void *userData, uint32_t actionIndex, void *actionData);
@@ -0,0 +1,239 @@
+// Headless mode.
+//
+// With no Wayland compositor we can still make windows and widgets and
+// draw them.  Turn it on with pnDisplay_setHeadless() before making any
+// windows, or with the environment variable PN_HEADLESS=1.
+//
+// Windows draw to plain memory buffers from mmap(2) in place of wl_shm
+// shared memory, and there are no Wayland objects at all.  In place of
+// the compositor's wl_callback frame events we have a synthetic clock
+// that pnDisplay_dispatch() moves ahead one refresh period each call,
+// drawing all the windows that asked for a frame.  So N calls to
+// pnDisplay_dispatch() is N frames, no matter how long they take, and
+// the results do not depend on a compositor or the speed of the
+// computer.  Pointer events come from the pnWindow_injectPointerMotion()
+// and pnDisplay_injectPointer*() functions, and the pixels can be read
+// back with pnWindow_getPixels().
+//
+// We use this for benchmarks, for tests that need to be the same every
+// run, and for drawing plots to image files on computers with no
+// compositor.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+#include <linux/input-event-codes.h>
+
+#include "../include/panels.h"
+#include "debug.h"
+#include "display.h"
+
+
+// Use headless mode with frames refresh nanoseconds apart on the
+// synthetic clock, or refresh = 0 for PN_HEADLESS_REFRESH (60 Hz).
+//
+// Returns true on failure, like if we already connected to a Wayland
+// compositor.
+//
+bool pnDisplay_setHeadless(uint64_t refresh) {
+
+    if(d.wl_display) {
+        ERROR("We already have a Wayland display");
+        return true;
+    }
+
+    d.headlessRefresh = refresh ? refresh : PN_HEADLESS_REFRESH;
+
+    if(d.headless) return false;
+
+    d.headless = true;
+    return (bool) _pnDisplay_create();
+}
+
+
+static inline bool Frame(struct PnWindow *win, uint32_t msec) {
+
+    if(!win->headlessFrame || !win->headlessShown) return false;
+
+    // The window can ask for the next frame while we draw this one.
+    win->headlessFrame = false;
+    FrameDone(win, msec);
+    return true;
+}
+
+// Move the synthetic clock ahead one frame and do the frame callbacks
+// of the windows that asked for one.  Returns true if there were any.
+//
+bool HeadlessDispatch(void) {
+
+    DASSERT(d.headless);
+    DASSERT(d.headlessRefresh);
+
+    d.headlessTime += d.headlessRefresh;
+    // The wl_callback time stamp is in milliseconds.
+    uint32_t msec = d.headlessTime/1000000;
+    bool drew = false;
+
+    for(struct PnWindow *win = d.windows; win; win = win->prev) {
+        for(struct PnWindow *p = win->toplevel.popups; p; p = p->prev)
+            drew |= Frame(p, msec);
+        drew |= Frame(win, msec);
+    }
+
+    return drew;
+}
+
+
+static inline bool NotHeadless(void) {
+
+    if(d.headless) return false;
+
+    ERROR("Pointer events can only be injected in headless mode");
+    return true;
+}
+
+// Move the pointer to x,y in the window, like the compositor would send
+// a pointer enter event, or a pointer motion event if the pointer is
+// already in the window.  x,y is relative to the window.  If x,y is not
+// in the window, and there is no button grab, the pointer leaves the
+// window.
+//
+// Returns true on failure.
+//
+bool pnWindow_injectPointerMotion(struct PnWidget *w, double x, double y) {
+
+    DASSERT(w);
+    ASSERT(w->type & (TOPLEVEL | POPUP));
+    struct PnWindow *win = (void *) w;
+
+    if(NotHeadless()) return true;
+
+    if(!win->headlessShown || !w->allocation.width ||
+            !w->allocation.height) {
+        ERROR("The window has not been drawn yet");
+        return true;
+    }
+
+    if(x < 0.0 || y < 0.0 || x >= w->allocation.width ||
+            y >= w->allocation.height) {
+        if(d.pointerWindow == win && !d.buttonGrab) {
+            DoPointerLeave();
+            return false;
+        }
+        if(d.pointerWindow != win)
+            // It's not in the window.
+            return false;
+    }
+
+    wl_fixed_t fx = wl_fixed_from_double(x);
+    wl_fixed_t fy = wl_fixed_from_double(y);
+
+    if(d.pointerWindow == win) {
+        PointerMotion(fx, fy);
+        return false;
+    }
+
+    if(d.pointerWindow)
+        DoPointerLeave();
+    DoPointerEnter(win, 0/*serial*/, fx, fy);
+    return false;
+}
+
+// The pointer leaves the window it's in, if it's in one.
+//
+bool pnDisplay_injectPointerLeave(void) {
+
+    if(NotHeadless()) return true;
+
+    if(d.pointerWindow)
+        DoPointerLeave();
+    return false;
+}
+
+// button is BTN_LEFT, BTN_MIDDLE, or BTN_RIGHT from
+// <linux/input-event-codes.h>.  The press or release is at the last
+// position from pnWindow_injectPointerMotion().
+//
+bool pnDisplay_injectPointerButton(uint32_t button, bool pressed) {
+
+    if(NotHeadless()) return true;
+
+    DoPointerButton(button, pressed ? WL_POINTER_BUTTON_STATE_PRESSED :
+            WL_POINTER_BUTTON_STATE_RELEASED);
+    return false;
+}
+
+// which is 0 for a vertical scroll, 1 for horizontal, like
+// wl_pointer_axis.
+//
+bool pnDisplay_injectPointerAxis(uint32_t which, double value) {
+
+    if(NotHeadless()) return true;
+
+    DoPointerAxis(d.headlessTime/1000000, which, value);
+    return false;
+}
+
+
+// Returns the pixels of the window from the last frame that was drawn,
+// or 0 if the window has not been drawn.  The pixels are 4 bytes, ARGB
+// (or XRGB, see pnWindow_setPixelFormat()) with stride pixels from one
+// row to the next.  They are good until the next frame is drawn, or the
+// window is hidden or destroyed.
+//
+// This works with or without headless mode; but with a compositor we
+// may be drawing the next frame in them now and then.
+//
+const uint32_t *pnWindow_getPixels(const struct PnWidget *w,
+        uint32_t *width, uint32_t *height, uint32_t *stride) {
+
+    DASSERT(w);
+    ASSERT(w->type & (TOPLEVEL | POPUP));
+    const struct PnWindow *win = (const void *) w;
+    const struct PnBuffer *buffer = &win->buffer;
+
+    if(!HaveBuffer(buffer)) return 0;
+
+    if(width) *width = buffer->width;
+    if(height) *height = buffer->height;
+    if(stride) *stride = buffer->stride;
+    return buffer->pixels;
+}
+
+
+#ifdef WITH_CAIRO
+// Write the pixels of the window from the last frame to a PNG file.
+//
+// Returns true on failure.
+//
+bool pnWindow_writePNG(const struct PnWidget *w, const char *filename) {
+
+    DASSERT(filename);
+    uint32_t width, height, stride;
+    const uint32_t *pixels = pnWindow_getPixels(w, &width, &height,
+            &stride);
+    if(!pixels) {
+        ERROR("The window has not been drawn yet");
+        return true;
+    }
+
+    const struct PnWindow *win = (const void *) w;
+    cairo_surface_t *surface = cairo_image_surface_create_for_data(
+            (unsigned char *) pixels,
+            (win->buffer.format == WL_SHM_FORMAT_ARGB8888) ?
+                CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+            width, height, stride * PN_PIXEL_SIZE);
+    cairo_status_t status = cairo_surface_status(surface);
+    if(status == CAIRO_STATUS_SUCCESS)
+        status = cairo_surface_write_to_png(surface, filename);
+    cairo_surface_destroy(surface);
+
+    if(status != CAIRO_STATUS_SUCCESS) {
+        ERROR("Writing PNG file \"%s\" failed: %s", filename,
+                cairo_status_to_string(status));
+        return true;
+    }
+    return false;
+}
+#endif
@@ -23,6 +23,28 @@ struct PnFD {
     bool isReader;
 };
 
+// Used to add timers to the optional main loop stuff.
+struct PnTimer {
+
+    // Times are in nanoseconds from CLOCK_MONOTONIC.
+    //
+    // We call the callback after "deadline" and before deadline + slack,
+    // give or take a millisecond.  With slack we can wake up once for
+    // many timers.
+    uint64_t deadline, period, slack;
+
+    void *userData;
+    // returns 0 to keep going
+    // returns 1 to have the timer removed
+    //
+    // It's 0 for a timer that was removed while we were calling timer
+    // callbacks.
+    int (*callback)(struct PnTimer *timer, void *userData);
+
+    // We keep a list of struct PnTimer:
+    struct PnTimer *next;
+};
+
 
 struct PnMainLoop {
     //
@@ -43,9 +65,23 @@ struct PnMainLoop {
     struct PnFD *readers; // list of readers
     struct PnFD *writers; // list of writers
     int epollFd;
+
+    // We do not expect many timers, so it's just a list, and we look at
+    // all of them to get the epoll_wait(2) timeout.
+    struct PnTimer *timers;
+    // Set while we call the timer callbacks.
+    bool doingTimers;
 };
 
 
+static inline uint64_t MainLoopClock(void) {
+
+    struct timespec t;
+    ASSERT(0 == clock_gettime(CLOCK_MONOTONIC, &t));
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
 static inline void FreeFd(struct PnFD *f) {
 
     DZMEM(f, sizeof(*f));
@@ -91,6 +127,12 @@ static inline bool RemoveFd(struct PnMainLoop *ml,
 }
 
 
+static inline void FreeTimer(struct PnTimer *t) {
+
+    DZMEM(t, sizeof(*t));
+    free(t);
+}
+
 static inline void pnMainLoop_destroy(struct PnMainLoop *ml) {
 
     DASSERT(ml);
@@ -100,6 +142,11 @@ static inline void pnMainLoop_destroy(struct PnMainLoop *ml) {
         RemoveFd(ml, &ml->readers, ml->readers);
     while(ml->writers)
         RemoveFd(ml, &ml->writers, ml->writers);
+    while(ml->timers) {
+        struct PnTimer *t = ml->timers;
+        ml->timers = t->next;
+        FreeTimer(t);
+    }
 
     if(ml->epollFd >= 0)
         close(ml->epollFd);
@@ -173,6 +220,26 @@ static inline bool pnMainLoop_addReader(struct PnMainLoop *ml,
     return false; // success
 }
 
+static inline bool pnMainLoop_addWriter(struct PnMainLoop *ml,
+        int fd, int (*write)(int fd, void *userData), void *userData) {
+
+    DASSERT(ml);
+    DASSERT(ml->epollFd >= 0);
+
+    struct PnFD *n = AddFD(&ml->writers, fd, write, userData);
+
+    struct epoll_event ee;
+    ee.events = EPOLLOUT;
+    ee.data.ptr = n;
+
+    if(epoll_ctl(ml->epollFd, EPOLL_CTL_ADD, fd, &ee) != 0) {
+        ERROR("epoll_ctl(%d,,,) failed", ml->epollFd);
+        return true;
+    }
+
+    return false; // success
+}
+
 static inline bool
 pnMainLoop_removeReader(struct PnMainLoop *ml, int fd) {
     DASSERT(ml);
@@ -239,6 +306,121 @@ DoWriter(struct PnMainLoop *ml, struct PnFD *f) {
 }
 
 
+static inline struct PnTimer *pnMainLoop_addTimer(struct PnMainLoop *ml,
+        uint64_t timeout, uint64_t period, uint64_t slack,
+        int (*callback)(struct PnTimer *timer, void *userData),
+        void *userData) {
+
+    DASSERT(ml);
+    DASSERT(callback);
+
+    struct PnTimer *t = calloc(1, sizeof(*t));
+    ASSERT(t, "calloc(1, %zu) failed", sizeof(*t));
+
+    t->deadline = MainLoopClock() + timeout;
+    t->period = period;
+    t->slack = slack;
+    t->callback = callback;
+    t->userData = userData;
+
+    // Add "t" to the end of the list:
+    struct PnTimer **last = &ml->timers;
+    while(*last) last = &(*last)->next;
+    *last = t;
+    return t;
+}
+
+static inline bool
+pnMainLoop_removeTimer(struct PnMainLoop *ml, struct PnTimer *t) {
+
+    DASSERT(ml);
+    DASSERT(t);
+
+    struct PnTimer **prev = &ml->timers;
+    while(*prev && *prev != t)
+        prev = &(*prev)->next;
+
+    if(!*prev) {
+        ERROR("Timer %p not found", t);
+        return true;
+    }
+
+    if(ml->doingTimers) {
+        // DoTimers() is looking at the list, so it frees it.
+        t->callback = 0;
+        return false;
+    }
+
+    *prev = t->next;
+    FreeTimer(t);
+    return false; // success.
+}
+
+// Returns the epoll_wait(2) timeout in milliseconds for the timers, or
+// -1 if there are none.
+//
+static inline int TimerTimeout(struct PnMainLoop *ml) {
+
+    if(!ml->timers) return -1;
+
+    // Wake at the latest time that we can for the timer that needs it
+    // first.  Other timers that are due by then get called too.
+    uint64_t wake = UINT64_MAX;
+    for(struct PnTimer *t = ml->timers; t; t = t->next)
+        if(t->callback && t->deadline + t->slack < wake)
+            wake = t->deadline + t->slack;
+
+    uint64_t now = MainLoopClock();
+    if(wake <= now) return 0;
+    // Round up so we do not wake up before the deadline.
+    uint64_t ms = (wake - now + 999999)/1000000;
+    if(ms > INT32_MAX) ms = INT32_MAX;
+    return (int) ms;
+}
+
+// Call the callbacks of the timers that are due.
+//
+static inline void DoTimers(struct PnMainLoop *ml) {
+
+    if(!ml->timers) return;
+
+    uint64_t now = MainLoopClock();
+    ml->doingTimers = true;
+
+    // Timers added by the callbacks go at the end of the list, and
+    // we may call them too.
+    for(struct PnTimer *t = ml->timers; t; t = t->next) {
+        if(!t->callback || t->deadline > now) continue;
+        bool remove = !t->period;
+        if(t->period) {
+            t->deadline += t->period;
+            if(t->deadline <= now)
+                // We fell behind.  Skip the periods we missed.
+                t->deadline += ((now - t->deadline)/t->period + 1) *
+                        t->period;
+        }
+        if(t->callback(t, t->userData) == 1)
+            remove = true;
+        if(remove)
+            t->callback = 0;
+    }
+
+    ml->doingTimers = false;
+
+    // Free the removed timers.
+    struct PnTimer **prev = &ml->timers;
+    while(*prev) {
+        struct PnTimer *t = *prev;
+        if(t->callback) {
+            prev = &t->next;
+            continue;
+        }
+        *prev = t->next;
+        FreeTimer(t);
+    }
+}
+
+
 #define MAX_EVENTS  (7) // for epoll_wait().
 
 // This just does one loop iteration.
@@ -247,10 +429,10 @@ static inline bool pnMainLoop_wait(struct PnMainLoop *ml) {
 
     DASSERT(ml);
     DASSERT(ml->epollFd >= 0);
-    DASSERT(ml->readers || ml->writers);
+    DASSERT(ml->readers || ml->writers || ml->timers);
 
-    if(!ml->readers && !ml->writers) {
-        ERROR("No readers or writers loaded");
+    if(!ml->readers && !ml->writers && !ml->timers) {
+        ERROR("No readers, writers, or timers loaded");
         return true; // error
     }
 
@@ -258,9 +440,10 @@ static inline bool pnMainLoop_wait(struct PnMainLoop *ml) {
     // in the struct PnMainLoop?
     //
     struct epoll_event ev[MAX_EVENTS];
-    int nfds = epoll_wait(ml->epollFd, ev, MAX_EVENTS, -1/*timeout*/);
-    // We are not using a timeout, so it should not return 0.
-    DASSERT(nfds != 0);
+    int timeout = TimerTimeout(ml);
+    int nfds = epoll_wait(ml->epollFd, ev, MAX_EVENTS, timeout);
+    // Without timers there is no timeout, so it should not return 0.
+    DASSERT(nfds != 0 || timeout >= 0);
     if(nfds < 0) {
         ERROR("epoll_wait(%d,,,) failed", ml->epollFd);
         return true; // error
@@ -269,13 +452,15 @@ static inline bool pnMainLoop_wait(struct PnMainLoop *ml) {
         struct PnFD *f = ev[i].data.ptr;
         if(f->isReader) {
             if(DoReader(ml, f))
-                break;
+                return false;
         } else {
             if(DoWriter(ml, f))
-                break;
+                return false;
         }
     }
 
+    DoTimers(ml);
+
     return false; // success
 }
 
@@ -286,7 +471,7 @@ static inline bool pnMainLoop_run(struct PnMainLoop *ml,
 
     DASSERT(ml);
     DASSERT(ml->epollFd >= 0);
-    DASSERT(ml->readers || ml->writers);
+    DASSERT(ml->readers || ml->writers || ml->timers);
 
     do {
         int ret;
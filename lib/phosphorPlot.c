@@ -0,0 +1,314 @@
+// A scope plot that is drawn like a digital phosphor (intensity graded)
+// oscilloscope.
+//
+// Every point that the plotter draws adds to the intensity of its pixel,
+// in an array of uint16_t with one for each graph pixel.  Every draw
+// frame all the intensities decay (they are multiplied by a number less
+// than 1), the plotter draws the new points, and then all the graph
+// pixels are painted with the graph background blended with a color from
+// a table (LUT) that is indexed by the intensity.  So the pixels that the
+// signal goes through more often are brighter.  At sample rates like
+// millions of samples per second that shows a lot more than the last few
+// traces do.
+//
+// There are no lists of points.  A frame costs O(pixels + points): one
+// decay pass and one paint pass over the graph pixels, and one add for
+// each point.
+//
+// The paint pass paints every pixel in the graph, so it's one phosphor
+// plot per graph.  It's painted before the other scope plots in the
+// graph are drawn, so they are drawn on top of it; beam plots only show
+// the points of the current frame, like after a zoom.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <float.h>
+#include <math.h>
+
+#include <cairo/cairo.h>
+
+#include "../include/panels.h"
+
+#include "xdg-shell-protocol.h"
+#include "xdg-decoration-protocol.h"
+
+#include "debug.h"
+#include "display.h"
+#include "plot.h"
+#include "graph.h"
+
+
+#define NUM_COLORS  (256) // intensity levels, hits >> 8
+
+
+struct AddPhosphorParameters {
+
+    uint16_t hit, decay;
+};
+
+
+// persistence is the part of the intensity that is left after a draw
+// frame, 0 <= persistence < 1.  hitsToFull is the number of points drawn
+// on a pixel that make it full intensity.
+//
+struct PnPlot *pnScopePlot_createWithPhosphor(struct PnWidget *graph,
+        double persistence, uint32_t hitsToFull,
+        bool (*plotter)(struct PnWidget *graph, struct PnPlot *plot,
+            void *userData, double xMin, double xMax, double yMin, double yMax),
+        void *userData) {
+
+    ASSERT(persistence >= 0.0 && persistence < 1.0);
+    ASSERT(hitsToFull > 0);
+
+    struct AddPhosphorParameters par = {
+        .hit = (hitsToFull < 0xFFFF)?(0xFFFF/hitsToFull):1,
+        .decay = (uint16_t) (persistence * 0xFFFF + 0.5)
+    };
+
+    // TODO: Add type check here for graph?  Like ASSERT().
+    return pnWidget_addCallback(graph, PN_GRAPH_CB_SCOPE_PHOSPHOR,
+            plotter, userData, &par);
+}
+
+
+// Make the default colors from the point color.  The low half of the
+// intensities fade the point color in over the background, and the high
+// half go from the point color to white.
+//
+static void MakeColors(struct PnPlot *p) {
+
+    uint32_t *colors = p->raw.colors;
+    DASSERT(colors);
+    const uint32_t color = p->pointColor;
+
+    colors[0] = 0;
+
+    for(uint32_t i = 1; i < NUM_COLORS/2; ++i)
+        colors[i] = (color & 0x00FFFFFF) | ((2*i + 1) << 24);
+
+    for(uint32_t i = NUM_COLORS/2; i < NUM_COLORS; ++i)
+        colors[i] = Blend(0xFFFFFFFF, color,
+                2*(i - NUM_COLORS/2)) | 0xFF000000;
+
+    p->raw.colorsFrom = color;
+}
+
+// colors is NUM_COLORS (256) ARGB colors for the intensity levels, from
+// lowest to highest.  The alpha byte is how much of the color is blended
+// over the graph background.  colors = 0 goes back to the colors made
+// from the point color.
+//
+void pnPlot_setPhosphorColors(struct PnPlot *p, const uint32_t *colors) {
+
+    DASSERT(p);
+    ASSERT(p->drawMethod == PnDrawMethod_raw);
+    DASSERT(p->raw.colors);
+
+    if(!colors) {
+        p->raw.userColors = false;
+        MakeColors(p);
+        return;
+    }
+
+    memcpy(p->raw.colors, colors, NUM_COLORS * sizeof(*colors));
+    p->raw.colors[0] = 0;
+    p->raw.userColors = true;
+}
+
+
+// Free memory when the graph widget is destroyed.
+//
+static void destroy_phosphor(struct PnWidget *w, struct PnPlot *p) {
+
+    DASSERT(p);
+    DASSERT(w);
+    ASSERT(IS_TYPE1(w->type, PnWidgetType_graph));
+    DASSERT(p->drawMethod == PnDrawMethod_raw);
+
+    if(p->raw.hits) {
+        DZMEM(p->raw.hits, p->raw.width * p->raw.height *
+                sizeof(*p->raw.hits));
+        free(p->raw.hits);
+        p->raw.hits = 0;
+    }
+    if(p->raw.colors) {
+        DZMEM(p->raw.colors, NUM_COLORS * sizeof(*p->raw.colors));
+        free(p->raw.colors);
+        p->raw.colors = 0;
+    }
+}
+
+
+// Add a phosphor scope plot that does not use Cairo to draw.  Cairo is
+// still used to draw the grid background for the graph widget.
+//
+void AddScopePhosphorPlot(struct PnWidget *w, struct PnCallback *callback,
+        uint32_t actionIndex, void *actionData, void *addData) {
+
+    DASSERT(actionIndex == PN_GRAPH_CB_SCOPE_PHOSPHOR);
+    DASSERT(w);
+    ASSERT(IS_TYPE1(w->type, PnWidgetType_graph));
+    DASSERT(addData);
+
+    // Set the plot default settings:
+    struct PnPlot *p = (void *) callback;
+
+    struct PnGraph *g = (void *) w;
+    p->type = PnPlotType_dynamic;
+    //                 A R G B
+    p->lineColor =  0xFFF0F030;
+    p->pointColor = 0xFF30F030;
+    p->lineWidth = 0.0;
+    p->pointSize = 0.0;
+    p->graph = g;
+
+    p->drawMethod = PnDrawMethod_raw;
+
+    struct AddPhosphorParameters *par = addData;
+    p->raw.hit = par->hit;
+    p->raw.decay = par->decay;
+
+    p->raw.colors = calloc(NUM_COLORS, sizeof(*p->raw.colors));
+    ASSERT(p->raw.colors, "calloc(%d,%zu) failed",
+            NUM_COLORS, sizeof(*p->raw.colors));
+    MakeColors(p);
+
+    pnWidget_addDestroy(w, (void *) destroy_phosphor, p);
+
+    // TODO: removing scopes?
+    if(!p->graph->have_scopes)
+        p->graph->have_scopes = true;
+}
+
+
+typedef uint16_t V8s __attribute__((vector_size(8*sizeof(uint16_t))));
+typedef uint32_t V8i __attribute__((vector_size(8*sizeof(uint32_t))));
+
+// hits = hits * decay/65536, eight at a time with GCC vector extensions.
+//
+static inline void Decay(uint16_t *restrict hits, size_t n,
+        uint32_t decay) {
+
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8) {
+        V8s h;
+        memcpy(&h, hits + i, sizeof(h));
+        V8i x = __builtin_convertvector(h, V8i);
+        x = (x * decay) >> 16;
+        h = __builtin_convertvector(x, V8s);
+        memcpy(hits + i, &h, sizeof(h));
+    }
+
+    for(; i < n; ++i)
+        hits[i] = (hits[i] * decay) >> 16;
+}
+
+
+// Paint all the graph pixels: the background blended with the colors of
+// the intensities.
+//
+static void Paint(struct PnPlot *p, struct PnGraph *g) {
+
+    const uint32_t width = p->raw.width;
+    const uint32_t height = p->raw.height;
+    const uint16_t *hits = p->raw.hits;
+    const uint32_t *colors = p->raw.colors;
+
+    const uint32_t stride = g->widget.window->buffer.stride;
+    uint32_t *pixels = g->widget.window->buffer.pixels +
+            g->widget.allocation.x + g->widget.allocation.y * stride;
+
+    // The background is in the graph bgSurface where it's offset by the
+    // pad and the slide; see OverlayGridSurface() and
+    // CreateGraphSurface() in graph.c.
+    cairo_surface_flush(g->bgSurface.surface);
+    const uint32_t bgStride = g->width + 2 * g->padX;
+    const uint32_t *bg = (const uint32_t *)
+        cairo_image_surface_get_data(g->bgSurface.surface);
+    DASSERT(bg);
+    bg += (g->padY - g->slideY) * bgStride + g->padX - g->slideX;
+
+    for(uint32_t y = 0; y < height; ++y) {
+        for(uint32_t x = 0; x < width; ++x) {
+            uint32_t level = hits[x] >> 8;
+            if(!level) {
+                pixels[x] = bg[x];
+                continue;
+            }
+            uint32_t c = colors[level];
+            uint32_t a = c >> 24;
+            // a from 0 to 255 is a weight from 0 to 256.
+            pixels[x] = Blend(c | 0xFF000000, bg[x], a + (a >> 7));
+        }
+        hits += width;
+        pixels += stride;
+        bg += bgStride;
+    }
+}
+
+
+// Call the users callback for the phosphor scope plot.
+//
+bool ScopePhosphorDrawAction(struct PnGraph *g, struct PnCallback *callback,
+        bool (*userCallback)(struct PnWidget *g, struct PnPlot *p,
+                void *userData,
+                double xMin, double xMax, double yMin, double yMax),
+        void *userData, uint32_t actionIndex, void *actionData) {
+    DASSERT(g);
+    DASSERT(actionData == 0);
+    DASSERT(actionIndex == PN_GRAPH_CB_SCOPE_PHOSPHOR);
+    DASSERT(g->zoom);
+    DASSERT(g->bgSurface.surface);
+    DASSERT(g->scopeSurface.surface);
+    ASSERT(IS_TYPE1(g->widget.type, PnWidgetType_graph));
+    DASSERT(userCallback);
+    DASSERT(g->have_scopes);
+    DASSERT(g->widget.cairo_surface == g->scopeSurface.surface);
+
+    struct PnPlot *p = (void *) callback;
+    DASSERT(p->drawMethod == PnDrawMethod_raw);
+
+    uint32_t width = g->widget.allocation.width;
+    uint32_t height = g->widget.allocation.height;
+    DASSERT(width);
+    DASSERT(height);
+    DASSERT(width == g->width);
+    DASSERT(height == g->height);
+    DASSERT(g->widget.window->buffer.pixels);
+
+    p->zoom = g->zoom;
+    p->shiftX = g->padX - g->slideX;
+    p->shiftY = g->padY - g->slideY;
+
+    if(!p->raw.hits || p->raw.width != width || p->raw.height != height) {
+        // The old intensities are for the old pixels, so we start over.
+        size_t size = width * height * sizeof(*p->raw.hits);
+        p->raw.hits = realloc(p->raw.hits, size);
+        ASSERT(p->raw.hits, "realloc(,%zu) failed", size);
+        memset(p->raw.hits, 0, size);
+        p->raw.width = width;
+        p->raw.height = height;
+    } else
+        Decay(p->raw.hits, width * height, p->raw.decay);
+
+    if(!p->raw.userColors && p->raw.colorsFrom != p->pointColor)
+        // pnPlot_setPointColor() was called.
+        MakeColors(p);
+
+    // userCallback() adds the points to p->raw.hits.
+    PlotRingBegin(p);
+    bool ret = userCallback(&g->widget, p, userData,
+            g->xMin, g->xMax, g->yMin, g->yMax);
+    PlotRingEnd(p);
+
+    Paint(p, g);
+
+    // We painted over any beams in this graph.
+    g->beamReset = true;
+
+    return ret;
+}
@@ -40,3 +40,61 @@ void pnPlot_setPointSize(struct PnPlot *p, double size) {
     DASSERT(size >= 0);
     p->pointSize = size;
 }
+
+
+// The ring is read only in the main thread, in the scope plot draw
+// action, so we need no more than the ring's own thread safety between
+// the ring's producer and us.
+//
+void pnPlot_setRing(struct PnPlot *p, struct PnRing *ring,
+        uint32_t newest) {
+    DASSERT(p);
+    DASSERT(p->type == PnPlotType_dynamic);
+    p->ring = ring;
+    p->ringNewest = newest;
+    p->ringFirst = 0;
+    p->ringSecond = 0;
+    p->ringNumFirst = 0;
+    p->ringNumSecond = 0;
+}
+
+uint32_t pnPlot_getRingSamples(const struct PnPlot *p,
+        const void **first, uint32_t *numFirst,
+        const void **second, uint32_t *numSecond) {
+    DASSERT(p);
+    DASSERT(first);
+    DASSERT(numFirst);
+    DASSERT(second);
+    DASSERT(numSecond);
+
+    *first = p->ringFirst;
+    *numFirst = p->ringNumFirst;
+    *second = p->ringSecond;
+    *numSecond = p->ringNumSecond;
+    return p->ringNumFirst + p->ringNumSecond;
+}
+
+void PlotRingBegin(struct PnPlot *p) {
+
+    DASSERT(p);
+    if(!p->ring) return;
+
+    pnRing_readBegin(p->ring, p->ringNewest,
+            &p->ringFirst, &p->ringNumFirst,
+            &p->ringSecond, &p->ringNumSecond);
+}
+
+// The plotter callback has all the samples we gave it, so the producer
+// can write over them now.
+//
+void PlotRingEnd(struct PnPlot *p) {
+
+    DASSERT(p);
+    if(!p->ring) return;
+
+    pnRing_readEnd(p->ring, p->ringNumFirst + p->ringNumSecond);
+    p->ringFirst = 0;
+    p->ringSecond = 0;
+    p->ringNumFirst = 0;
+    p->ringNumSecond = 0;
+}
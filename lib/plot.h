@@ -20,64 +20,54 @@ enum PnDrawMethod {
 
 
 
-// TODO: this is too large.  It will cause us to allocate a lot of memory.
-//
-struct PnBeamPoint {
-
-    struct PnBeamPoint *next, *prev;
-    uint32_t *pixel; // the mapped pixel
-    struct PnBeam *beam;
-    int32_t time; // the beam time when this was written
-    uint32_t orgColor;
-};
-
-
 // For time faded beam oscilloscope using just single pixel points per
 // user plot draw point.
 //
-// This is the use less memory method (not as big as the widget pixel
-// buffer, if there are fewer stored points per draw frame):
-//
-// This uses a linked list of "points" that when in use are drawn at every
-// frame; for example every 0.01667 seconds (at 60 Hz) we draw and fade
-// all active points from first to last.  For performance this assumes
-// that the list is small compared to the number of pixels in the graph
-// widget.
-//
-// Drawing more than the BeamPoint list in a frame will simply overwrite
-// the older values of the BeamPoint buffer.
+// Each drawn beam point goes in a ring buffer of the last maxPoints
+// points in the beam, struct PnBeam::points, in the order they were
+// drawn; so the age of a point is how far it is behind the newest one
+// in the ring.  Every frame the plotter draws points, and for each new
+// point we take the oldest point out of the ring (it's maxPoints old),
+// and put back the color that was there before we drew it.  The points
+// that are older than maxPoints - fadePoints get faded.
 //
-// We make (more memory) an array of points that maps one to one to all
-// the available pixels in the graph widget. The linked list is embedded
-// in the array.  When points in the array are overwritten (by user
-// plotting) the color, and prev (and next?) of that point and it's
-// neighboring points are patched.  This could keep us from redundant
-// pixel coloring, but at a cost of using lots of unused memory given that
-// we are coloring only a small portion of all the pixels that the graph
-// widget has.  We'd copy the embedded list to the graph widget pixel
-// buffer for every draw frame, as this does now.  The old quickscope
-// project does this.
+// The graph has an array with one small struct PnBeamPixel for each of
+// its pixels, for the color that was there before a beam drew on it
+// (orgColor), and which beam point (if any) it shows now (stamp).  Every
+// point drawn gets a new stamp from the graph.  When a pixel gets drawn
+// again, by this beam or another beam in the graph, the old point in the
+// ring has the old stamp and so we know that it no longer owns the
+// pixel, and we skip it.
 //
-// We should be able to keep a user (and underlying) interfaces the same
-// for both of the two methods (1, 2 above).  So, we could seamlessly
-// switch between the two methods, assuming we implement both methods.
+// We used to have a 40 byte point struct with a doubly linked list for
+// each graph pixel.  This is 8 bytes per graph pixel plus 8 bytes for
+// each point in a beam's ring.
 //
+struct PnBeamPixel {
+
+    // 0 if no beam point is on this pixel.
+    uint32_t stamp;
+    uint32_t orgColor;
+};
+
+struct PnBeamPoint {
+
+    // x | y << 16 in the graph widget.
+    uint32_t xy;
+    // The stamp that the pixel had when we drew this point; 0 for
+    // none.
+    uint32_t stamp;
+};
+
 struct PnBeam {
 
     uint32_t *pixels;
     uint32_t stride;
 
-    // These point to the graph struct PnBeamPoint *beamPoints array
-    // elements.
-    struct PnBeamPoint
-        *first, // the oldest point in this beam
-        *last;  // the newest point in this beam
-
-    // A looping age point counter.  We assume that the points come in at
-    // a regular rate, so time is proportional to the current point count.
-    // Though if there is a trigger and it skips drawing frames this will
-    // not be proportional to time.
-    int32_t time;
+    // Ring buffer of the last maxPoints points drawn.  head is the newest
+    // point.  It's 0 for maxPoints = 0.
+    struct PnBeamPoint *points;
+    uint32_t head;
 
     // The maximum number of points displayed.
     //
@@ -88,6 +78,11 @@ struct PnBeam {
     // The number of points that are faded at the end of the stored
     // points that are displayed.  The length of the fading tail.
     int32_t fadePoints;
+
+    // The blend weight, in 256ths of the original pixel color, for each
+    // point in the fading tail, from the youngest faded point to the
+    // oldest; fadePoints of them.  It's 0 for maxPoints = 0.
+    uint16_t *fadeWeights;
 };
 
 
@@ -119,7 +114,26 @@ struct PnPlot {
 
         struct PnBeam *beam;
 
+        // The digital phosphor (intensity graded) scope.  See
+        // phosphorPlot.c.
         struct {
+            // The intensity of each graph pixel, width x height.  Every
+            // point drawn on a pixel adds "hit" to it, up to 0xFFFF.
+            uint16_t *hits;
+            uint32_t width, height;
+            uint16_t hit;
+            // Every draw frame the intensities are multiplied by
+            // decay/65536.
+            uint16_t decay;
+            // The color for each intensity level, hits >> 8.  The alpha
+            // byte is how much of the color is blended over the graph
+            // background.  colors[0] is not used; those pixels show the
+            // background.
+            uint32_t *colors;
+            // The point color that we made the colors from, so we make
+            // them again if it changes; unless the user set the colors.
+            uint32_t colorsFrom;
+            bool userColors;
         } raw;
     };
 
@@ -136,6 +150,15 @@ struct PnPlot {
     uint32_t lineColor, pointColor;
 
     double lineWidth, pointSize;
+
+    // An optional sample ring that the plotter callback reads with
+    // pnPlot_getRingSamples().  ringFirst and ringSecond are what we got
+    // from pnRing_readBegin() just before the plotter callback.
+    struct PnRing *ring;
+    uint32_t ringNewest;
+    const void *ringFirst, *ringSecond;
+    uint32_t ringNumFirst, ringNumSecond;
+
     // The last point drawn is needed to draw lines when
     // there is a line being drawn in the future.
     double x, y; // last point
@@ -26,208 +26,223 @@
 #include "graph.h"
 
 
-static inline uint32_t
-GetByte(uint32_t toColor, uint32_t fromColor, double fade, double org,
-        uint32_t mask) {
+// Returns the beam pixel of the point "pt" if the point still owns it,
+// else 0.
+//
+static inline struct PnBeamPixel *
+Owner(const struct PnGraph *g, const struct PnBeamPoint *pt) {
 
-    fromColor &= mask;
-    toColor &= mask;
+    if(!BeamStampValid(g, pt->stamp)) return 0;
 
-    double x = toColor * fade + fromColor * org;
-    if(x >= (double) mask)
-        return mask;
-    else
-        toColor = (uint32_t) x;
+    uint32_t x = pt->xy & 0xFFFF;
+    uint32_t y = pt->xy >> 16;
+    // The graph may have been resized since we drew the point.
+    if(x >= g->beamPixels_width || y >= g->beamPixels_height)
+        return 0;
 
-    return (toColor & mask);
+    struct PnBeamPixel *bp = g->beamPixels + g->beamPixels_width * y + x;
+    if(bp->stamp != pt->stamp)
+        return 0;
+    return bp;
 }
 
-
-
-// Returns the new faded color.
+// The window widget pixel for the beam point "pt".
 //
-static inline
-uint32_t Fade(uint32_t toColor, uint32_t fromColor, double fade) {
-
-    double org = 1.0 - fade;
-
-    // Relative amount of fade.
-    // 0.0 <= fade < 1.0
-    //
-    // fade == 1.0  is toColor
-    // fade == 0.0  is fromColor
-
-    // Color is 32 bit in the order Alpha Red Green Blue one byte each.
-    //
-    // We just need to compute each color component separately
-
-    return
-        GetByte(toColor, fromColor, fade, org, 0xFF000000) | // Alpha
-        GetByte(toColor, fromColor, fade, org, 0x00FF0000) | // Red
-        GetByte(toColor, fromColor, fade, org, 0x0000FF00) | // Blue
-        GetByte(toColor, fromColor, fade, org, 0x000000FF);  // Green
-}
-
-
-static void
-Beam_drawPoint(struct PnPlot *p, double x, double y) {
-
-    DASSERT(p);
-    DASSERT(p->drawMethod == PnDrawMethod_beam);
-
-    struct PnGraph *g = p->graph;
-    DASSERT(g);
-    DASSERT(g->beamPoints);
-    DASSERT(g->widget.allocation.width == g->beamPoints_width);
-    DASSERT(g->widget.allocation.height == g->beamPoints_height);
+static inline uint32_t *
+Pixel(const struct PnGraph *g, const struct PnBeam *beam,
+        const struct PnBeamPoint *pt) {
 
-    struct PnBeam *beam = p->beam;
-    DASSERT(beam);
+    return beam->pixels
+        + g->widget.allocation.x + (pt->xy & 0xFFFF)
+        + (g->widget.allocation.y + (pt->xy >> 16)) * beam->stride;
+}
 
-    struct PnZoom *z = p->zoom;
-    DASSERT(z);
-    // We need the positions in the window widget space:
-    uint32_t xi = xToPix(x, z) - p->shiftX + g->widget.allocation.x;
-    uint32_t yi = yToPix(y, z) - p->shiftY + g->widget.allocation.y;
 
-    // Cull if out of bounds.
-    if(xi < g->widget.allocation.x ||
-            xi >= g->widget.allocation.x + g->widget.allocation.width)
-        return;
-    if(yi < g->widget.allocation.y ||
-            yi >= g->widget.allocation.y + g->widget.allocation.height)
-        return;
+// Draw a beam point at xi, yi, that is in the window widget space and in
+// the graph widget.
+//
+static inline void
+Beam_drawPixel(struct PnPlot *p, struct PnGraph *g, struct PnBeam *beam,
+        uint32_t xi, uint32_t yi) {
 
-    // Increment the current pointTime:
-    ++beam->time;
+    DASSERT(xi >= g->widget.allocation.x);
+    DASSERT(xi < g->widget.allocation.x + g->widget.allocation.width);
+    DASSERT(yi >= g->widget.allocation.y);
+    DASSERT(yi < g->widget.allocation.y + g->widget.allocation.height);
+    DASSERT(g->beamPixels);
 
     // Find this pixel in the window widget buffer memory:
     uint32_t *pixel = beam->pixels
         + xi
         + yi * beam->stride;
 
-    // Find the x and y in the beamPoints array space.
+    // Find the x and y in the beamPixels array space.
     xi -= g->widget.allocation.x;
     yi -= g->widget.allocation.y;
 
-    struct PnBeamPoint *bp = g->beamPoints +
-        g->widget.allocation.width * yi + xi;
-    DASSERT(bp);
+    struct PnBeamPixel *bp = g->beamPixels +
+        g->beamPixels_width * yi + xi;
 
-    // Make it newer.
-    bp->time = beam->time;
-
-    if(bp->pixel) {
-        if(beam->last == bp)
-            // Same as last point.
-            return;
-        // We commandeer this bp entry:
-        //
-        // Remove this beam point from it's list.
-        if(bp->next) {
-            DASSERT(bp->beam->last != bp);
-            bp->next->prev = bp->prev;
-        } else {
-            DASSERT(bp->beam->last == bp);
-            bp->beam->last = bp->prev;
-        }
-        if(bp->prev) {
-            DASSERT(bp->beam->first != bp);
-            bp->prev->next = bp->next;
-            bp->prev = 0;
-        } else {
-            DASSERT(bp->beam->first == bp);
-            bp->beam->first = bp->next;
-        }
-        bp->next = 0;
-
-        // bp->orgColor stays the same.
-    } else {
-        DASSERT(!bp->next);
-        DASSERT(!bp->prev);
+    if(!BeamStampValid(g, bp->stamp))
+        // No beam point is on this pixel, so it has the color that we
+        // put back later.
         bp->orgColor = *pixel;
-        bp->pixel = pixel;
-        bp->beam = beam;
-    }
+    // else we commandeer this pixel from the point that had it, in this
+    // beam or another beam, and bp->orgColor stays the same.
 
-    // Add this beam point (bp) to the last in the beams point list.
-    //
-    bp->prev = beam->last;
-    if(beam->last) {
-        DASSERT(!beam->last->next);
-        DASSERT(beam->first);
-        DASSERT(!beam->first->prev);
-        beam->last->next = bp;
-    }
-    beam->last = bp;
-    if(bp->prev) {
-        DASSERT(beam->first);
-        DASSERT(beam->first != bp);
-        bp->prev->next = bp;
-    } else {
-        DASSERT(!beam->first);
-        beam->first = bp;
-    }
+    // A new stamp; skipping 0 which means no point.
+    if(!++g->beamStamp)
+        ++g->beamStamp;
+    bp->stamp = g->beamStamp;
 
     // Set the pixel color.
     *pixel = p->pointColor;
 
     if(beam->maxPoints == 0)
-        // infinite number of points.
+        // infinite number of points.  We do not need to remember the
+        // points, they stay until the graph background is redrawn.
         return;
 
     ///////////////////////////////////////////////////
-    // Now clip and fade the beam.
+    // Now clip the beam.
     ///////////////////////////////////////////////////
 
-    for(bp = beam->first; bp;) {
-        // We start with the oldest (largest age) one.
-        int32_t age = beam->time - bp->time;
-        // age gets smaller (younger) as we loop.
+    const uint32_t maxPoints = beam->maxPoints;
 
-        if(age >= beam->maxPoints) {
+    if(++beam->head == maxPoints)
+        beam->head = 0;
+    struct PnBeamPoint *pt = beam->points + beam->head;
 
-            // This point is so old it will be changed to the original color,
-            // and the point will be removed from the list.
+    // The point that was here is maxPoints old, so it's removed and the
+    // pixel gets its original color back; if the point still has the
+    // pixel.
+    struct PnBeamPixel *old = Owner(g, pt);
+    if(old) {
+        *Pixel(g, beam, pt) = old->orgColor;
+        old->stamp = 0;
+    }
 
-            struct PnBeamPoint *next = bp->next;
+    pt->xy = xi | (yi << 16);
+    pt->stamp = bp->stamp;
 
-            // Remove this beam point, bp.
-            DASSERT(bp->pixel);
-            *bp->pixel = bp->orgColor;
-            memset(bp, 0, sizeof(*bp));
-            bp = next;
-            continue;
-        }
-        // else (age < beam->maxPoints)
-        break;
-    }
+    // The fading of the tail of the beam is done once a draw frame, in
+    // FadeBeam(), not here for every point.
+}
 
-    // Now bp is the new oldest point that we'll keep.
+// Fade the tail of the beam, the oldest fadePoints points, from the
+// point color toward the original colors of their pixels.  This is
+// called once a draw frame after the plotter callback draws the new
+// points.  The ages of the points only change when points are added, so
+// doing it once after all the points of the frame gets the same pixels
+// as doing it after each point, and it's O(fadePoints) and not
+// O(points x fadePoints).
+//
+void FadeBeam(struct PnPlot *p) {
 
-    // This loop just does the fading of pixels.
-    for(struct PnBeamPoint *pt = bp; pt; pt = pt->next) {
-        int32_t age = beam->time - pt->time;
-        // age gets smaller (younger) as we loop.
-        int32_t fade_age = beam->maxPoints - beam->fadePoints;
+    DASSERT(p);
+    struct PnBeam *beam = p->beam;
+    DASSERT(beam);
+    struct PnGraph *g = p->graph;
+    DASSERT(g);
+
+    if(beam->maxPoints == 0) return;
+    DASSERT(beam->fadeWeights);
+
+    const uint32_t maxPoints = beam->maxPoints;
+    const uint32_t fade_age = beam->maxPoints - beam->fadePoints;
+    const uint16_t *weights = beam->fadeWeights;
+    const uint32_t pointColor = p->pointColor;
+
+    // The ring slot of the point that is fade_age old.
+    uint32_t i = (beam->head + maxPoints - fade_age) % maxPoints;
 
-        if(age < fade_age) break;
+    for(uint32_t k = 0; k < (uint32_t) beam->fadePoints; ++k) {
 
-        // Fade this point pt.
-        //
-        *pt->pixel = Fade(pt->orgColor, p->pointColor,
-                (age - fade_age)/((double) fade_age));
+        struct PnBeamPoint *pt = beam->points + i;
+        // Going to older points is going back in the ring.
+        i = (i ? i : maxPoints) - 1;
+
+        struct PnBeamPixel *fp = Owner(g, pt);
+        if(!fp) continue;
+        *Pixel(g, beam, pt) = Blend(fp->orgColor, pointColor, weights[k]);
     }
+}
+
+
+static void
+Beam_drawPoint(struct PnPlot *p, double x, double y) {
+
+    DASSERT(p);
+    DASSERT(p->drawMethod == PnDrawMethod_beam);
 
-    if(beam->first == bp)
-        // No points removed.
+    struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(g->beamPixels);
+    DASSERT(g->widget.allocation.width == g->beamPixels_width);
+    DASSERT(g->widget.allocation.height == g->beamPixels_height);
+
+    struct PnBeam *beam = p->beam;
+    DASSERT(beam);
+
+    struct PnZoom *z = p->zoom;
+    DASSERT(z);
+    // We need the positions in the window widget space:
+    x = xToPix(x, z) - p->shiftX + g->widget.allocation.x;
+    y = yToPix(y, z) - p->shiftY + g->widget.allocation.y;
+
+    // Cull if out of bounds.  We cull before we make them integers, so
+    // that NaN and values that do not fit in an integer are culled too.
+    if(!(x >= g->widget.allocation.x &&
+            x < g->widget.allocation.x + g->widget.allocation.width &&
+            y >= g->widget.allocation.y &&
+            y < g->widget.allocation.y + g->widget.allocation.height))
         return;
 
-    beam->first = bp;
-    if(bp)
-        bp->prev = 0;
-    else
-        beam->last = 0;
+    Beam_drawPixel(p, g, beam, x, y);
+}
+
+// Add a hit to the phosphor intensity of the pixel at xi, yi, that is in
+// the window widget space and in the graph widget.
+//
+static inline void
+Raw_drawPixel(struct PnPlot *p, const struct PnGraph *g,
+        uint32_t xi, uint32_t yi) {
+
+    DASSERT(xi >= g->widget.allocation.x);
+    DASSERT(xi < g->widget.allocation.x + p->raw.width);
+    DASSERT(yi >= g->widget.allocation.y);
+    DASSERT(yi < g->widget.allocation.y + p->raw.height);
+
+    uint16_t *h = p->raw.hits + (xi - g->widget.allocation.x) +
+            (yi - g->widget.allocation.y) * p->raw.width;
+    uint32_t v = *h + p->raw.hit;
+    *h = (v < 0xFFFF)?v:0xFFFF;
+}
+
+static void
+Raw_drawPoint(struct PnPlot *p, double x, double y) {
+
+    DASSERT(p);
+    DASSERT(p->drawMethod == PnDrawMethod_raw);
+
+    struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(p->raw.hits);
+
+    struct PnZoom *z = p->zoom;
+    DASSERT(z);
+    // We need the positions in the window widget space:
+    x = xToPix(x, z) - p->shiftX + g->widget.allocation.x;
+    y = yToPix(y, z) - p->shiftY + g->widget.allocation.y;
+
+    // Cull if out of bounds, like in Beam_drawPoint().
+    if(!(x >= g->widget.allocation.x &&
+            x < g->widget.allocation.x + p->raw.width &&
+            y >= g->widget.allocation.y &&
+            y < g->widget.allocation.y + p->raw.height))
+        return;
+
+    Raw_drawPixel(p, g, x, y);
 }
 
 static void
@@ -269,10 +284,6 @@ Cairo_drawPoint(struct PnPlot *p, double x, double y) {
 }
 
 
-// TODO: This is likely called in a (tight loop) bottle-neck in most user
-// code, so we need to make it faster.  In-lining is step one?
-// Currently I'm not seeing it as a bottleneck.
-//
 void 
 pnPlot_drawPoint(struct PnPlot *p, double x, double y) {
 
@@ -284,7 +295,415 @@ pnPlot_drawPoint(struct PnPlot *p, double x, double y) {
         case PnDrawMethod_beam:
             Beam_drawPoint(p, x, y);
             return;
+        case PnDrawMethod_raw:
+            Raw_drawPoint(p, x, y);
+            return;
         default:
             ASSERT(0);
     }
 }
+
+
+///////////////////////////////////////////////////////////////////////
+// Drawing many points with one call.
+//
+// Calling pnPlot_drawPoint() for every point costs a function call, a
+// switch on the draw method, two double divides, and for Cairo a
+// cairo_stroke() for every line segment.  pnPlot_drawPoints() and
+// friends map a chunk of points to pixels in a loop with no branches,
+// four at a time with GCC vector extensions (SSE2 or AVX if the compiler
+// is told it can), then draw the chunk with one switch on the draw
+// method and, for Cairo, one stroke and one fill.  The results are the
+// same as calling pnPlot_drawPoint() for each point, except that Cairo
+// strokes the lines in a chunk as one path, so lines with a see-through
+// color do not get darker where they cross.
+///////////////////////////////////////////////////////////////////////
+
+// Number of points we map to pixels at a time.  The pixel positions are
+// on the stack.
+#define CHUNK  (1024)
+
+typedef double V4d __attribute__((vector_size(4*sizeof(double))));
+typedef float V4f __attribute__((vector_size(4*sizeof(float))));
+typedef int32_t V4i __attribute__((vector_size(4*sizeof(int32_t))));
+typedef int16_t V4s __attribute__((vector_size(4*sizeof(int16_t))));
+
+
+// pix = v * a + b
+//
+// We got a and b from the zoom so that this has no divide.
+//
+static inline void MapDoubles(double *restrict pix,
+        const double *restrict v, size_t stride, size_t n,
+        double a, double b) {
+
+    size_t i = 0;
+
+    if(stride == 1)
+        for(; i + 4 <= n; i += 4) {
+            V4d x;
+            memcpy(&x, v + i, sizeof(x));
+            x = x * a + b;
+            memcpy(pix + i, &x, sizeof(x));
+        }
+
+    for(; i < n; ++i)
+        pix[i] = v[i * stride] * a + b;
+}
+
+// Make MapFloats(), MapInt32(), and MapInt16(), that are like
+// MapDoubles() with stride 1, for other types.
+//
+#define MAP(NAME, TYPE, VTYPE)                                        \
+static inline void NAME(double *restrict pix,                         \
+        const TYPE *restrict v, size_t n, double a, double b) {       \
+                                                                      \
+    size_t i = 0;                                                     \
+                                                                      \
+    for(; i + 4 <= n; i += 4) {                                       \
+        VTYPE f;                                                      \
+        memcpy(&f, v + i, sizeof(f));                                 \
+        V4d x = __builtin_convertvector(f, V4d);                      \
+        x = x * a + b;                                                \
+        memcpy(pix + i, &x, sizeof(x));                               \
+    }                                                                 \
+                                                                      \
+    for(; i < n; ++i)                                                 \
+        pix[i] = v[i] * a + b;                                        \
+}
+
+MAP(MapFloats, float, V4f)
+MAP(MapInt32, int32_t, V4i)
+MAP(MapInt16, int16_t, V4s)
+
+#undef MAP
+
+// Map samples v[offset] to v[offset+n-1] of type "type".
+//
+static inline void MapSamples(double *restrict pix,
+        const void *v, enum PnSampleType type, size_t offset, size_t n,
+        double a, double b) {
+
+    switch(type) {
+        case PnSampleType_int16:
+            MapInt16(pix, ((const int16_t *) v) + offset, n, a, b);
+            return;
+        case PnSampleType_int32:
+            MapInt32(pix, ((const int32_t *) v) + offset, n, a, b);
+            return;
+        case PnSampleType_float:
+            MapFloats(pix, ((const float *) v) + offset, n, a, b);
+            return;
+        case PnSampleType_double:
+            MapDoubles(pix, ((const double *) v) + offset, 1, n, a, b);
+            return;
+    }
+    ASSERT(0, "Bad sample type %d", type);
+}
+
+
+// x and y are pixel positions on the Cairo surface.  This is like calling
+// Cairo_drawPoint() n times.
+//
+static void Cairo_drawPixels(struct PnPlot *p,
+        const double *x, const double *y, size_t n) {
+
+    DASSERT(n);
+
+    const double hw = p->pointSize;
+    const double w = 2.0*hw;
+    cairo_t *cr = p->cairo.line;
+    cairo_t *pcr = p->cairo.point;
+
+    double lastX = p->x, lastY = p->y;
+    size_t i = 0;
+
+    if(lastX == DBL_MAX) {
+        // It's the first point, so it does not get a line to it.
+        lastX = x[0];
+        lastY = y[0];
+        i = 1;
+    }
+
+    if(p->lineWidth > 0 && i < n) {
+        cairo_move_to(cr, lastX, lastY);
+        for(size_t j = i; j < n; ++j)
+            cairo_line_to(cr, x[j], y[j]);
+        cairo_stroke(cr);
+    }
+
+    if(p->pointSize) {
+        // Draw all but the last point.  We draw the last point when
+        // there is another one, or after the plotter callback returns.
+        if(!i)
+            cairo_rectangle(pcr, lastX - hw, lastY - hw, w, w);
+        for(size_t j = 0; j < n - 1; ++j)
+            cairo_rectangle(pcr, x[j] - hw, y[j] - hw, w, w);
+        cairo_fill(pcr);
+    }
+
+    p->x = x[n-1];
+    p->y = y[n-1];
+}
+
+// x and y are pixel positions in the window widget space.
+//
+static void Beam_drawPixels(struct PnPlot *p,
+        const double *x, const double *y, size_t n) {
+
+    DASSERT(p->drawMethod == PnDrawMethod_beam);
+
+    struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(g->beamPixels);
+    DASSERT(g->widget.allocation.width == g->beamPixels_width);
+    DASSERT(g->widget.allocation.height == g->beamPixels_height);
+
+    struct PnBeam *beam = p->beam;
+    DASSERT(beam);
+
+    const double xMin = g->widget.allocation.x;
+    const double xMax = xMin + g->widget.allocation.width;
+    const double yMin = g->widget.allocation.y;
+    const double yMax = yMin + g->widget.allocation.height;
+
+    for(size_t i = 0; i < n; ++i)
+        // Cull if out of bounds, like in Beam_drawPoint().
+        if(x[i] >= xMin && x[i] < xMax && y[i] >= yMin && y[i] < yMax)
+            Beam_drawPixel(p, g, beam, x[i], y[i]);
+}
+
+
+// x and y are pixel positions in the window widget space.
+//
+static void Raw_drawPixels(struct PnPlot *p,
+        const double *x, const double *y, size_t n) {
+
+    DASSERT(p->drawMethod == PnDrawMethod_raw);
+
+    const struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(p->raw.hits);
+
+    const double xMin = g->widget.allocation.x;
+    const double xMax = xMin + p->raw.width;
+    const double yMin = g->widget.allocation.y;
+    const double yMax = yMin + p->raw.height;
+
+    for(size_t i = 0; i < n; ++i)
+        if(x[i] >= xMin && x[i] < xMax && y[i] >= yMin && y[i] < yMax)
+            Raw_drawPixel(p, g, x[i], y[i]);
+}
+
+
+// Get a and b for pix = v * a + b in MapDoubles() and MapFloats().
+//
+static inline void GetMaps(const struct PnPlot *p,
+        double *xa, double *xb, double *ya, double *yb) {
+
+    const struct PnZoom *z = p->zoom;
+    DASSERT(z);
+
+    // xToPix(x, z) - shiftX = (x - xShift)/xSlope - shiftX
+    *xa = 1.0/z->xSlope;
+    *xb = - z->xShift/z->xSlope - p->shiftX;
+    *ya = 1.0/z->ySlope;
+    *yb = - z->yShift/z->ySlope - p->shiftY;
+
+    if(p->drawMethod != PnDrawMethod_cairo) {
+        // The beam and phosphor draw in the window widget space.
+        *xb += p->graph->widget.allocation.x;
+        *yb += p->graph->widget.allocation.y;
+    }
+}
+
+static inline void DrawPixels(struct PnPlot *p,
+        const double *x, const double *y, size_t n) {
+
+    switch(p->drawMethod) {
+
+        case PnDrawMethod_cairo:
+            Cairo_drawPixels(p, x, y, n);
+            return;
+        case PnDrawMethod_beam:
+            Beam_drawPixels(p, x, y, n);
+            return;
+        case PnDrawMethod_raw:
+            Raw_drawPixels(p, x, y, n);
+            return;
+        default:
+            ASSERT(0);
+    }
+}
+
+
+// Like calling pnPlot_drawPoint(p, x[i*xStride], y[i*yStride]) for i = 0
+// to n-1.  Strides are in doubles, so for x and y in one array like
+// x0,y0,x1,y1,... it's pnPlot_drawPointsStrided(p, xy, 2, xy + 1, 2, n).
+//
+void pnPlot_drawPointsStrided(struct PnPlot *p,
+        const double *x, size_t xStride,
+        const double *y, size_t yStride, size_t n) {
+
+    DASSERT(p);
+    DASSERT(x || !n);
+    DASSERT(y || !n);
+    DASSERT(xStride);
+    DASSERT(yStride);
+
+    double xa, xb, ya, yb;
+    GetMaps(p, &xa, &xb, &ya, &yb);
+
+    double px[CHUNK], py[CHUNK];
+
+    while(n) {
+        size_t num = (n < CHUNK)?n:CHUNK;
+        MapDoubles(px, x, xStride, num, xa, xb);
+        MapDoubles(py, y, yStride, num, ya, yb);
+        DrawPixels(p, px, py, num);
+        x += num * xStride;
+        y += num * yStride;
+        n -= num;
+    }
+}
+
+void pnPlot_drawPoints(struct PnPlot *p,
+        const double *x, const double *y, size_t n) {
+
+    pnPlot_drawPointsStrided(p, x, 1, y, 1, n);
+}
+
+void pnPlot_drawPointsf(struct PnPlot *p,
+        const float *x, const float *y, size_t n) {
+
+    DASSERT(p);
+    DASSERT(x || !n);
+    DASSERT(y || !n);
+
+    double xa, xb, ya, yb;
+    GetMaps(p, &xa, &xb, &ya, &yb);
+
+    double px[CHUNK], py[CHUNK];
+
+    while(n) {
+        size_t num = (n < CHUNK)?n:CHUNK;
+        MapFloats(px, x, num, xa, xb);
+        MapFloats(py, y, num, ya, yb);
+        DrawPixels(p, px, py, num);
+        x += num;
+        y += num;
+        n -= num;
+    }
+}
+
+
+// x is the pixel column, in the window widget space, in fixed point with
+// 32 bits after the binary point, and it goes up by dx for each sample.
+// y are pixel rows.
+//
+static void Beam_drawSamples(struct PnPlot *p,
+        int64_t x, int64_t dx, const double *y, size_t n) {
+
+    DASSERT(p->drawMethod == PnDrawMethod_beam);
+
+    struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(g->beamPixels);
+
+    struct PnBeam *beam = p->beam;
+    DASSERT(beam);
+
+    const int64_t xMin = g->widget.allocation.x;
+    const int64_t xMax = xMin + g->widget.allocation.width;
+    const double yMin = g->widget.allocation.y;
+    const double yMax = yMin + g->widget.allocation.height;
+
+    for(size_t i = 0; i < n; ++i, x += dx) {
+        // Rounds down, like the cull in Beam_drawPoint().
+        int64_t xi = x >> 32;
+        if(xi >= xMin && xi < xMax && y[i] >= yMin && y[i] < yMax)
+            Beam_drawPixel(p, g, beam, xi, y[i]);
+    }
+}
+
+// Like Beam_drawSamples() for the phosphor scope.
+//
+static void Raw_drawSamples(struct PnPlot *p,
+        int64_t x, int64_t dx, const double *y, size_t n) {
+
+    DASSERT(p->drawMethod == PnDrawMethod_raw);
+
+    const struct PnGraph *g = p->graph;
+    DASSERT(g);
+    DASSERT(p->raw.hits);
+
+    const int64_t xMin = g->widget.allocation.x;
+    const int64_t xMax = xMin + p->raw.width;
+    const double yMin = g->widget.allocation.y;
+    const double yMax = yMin + p->raw.height;
+
+    for(size_t i = 0; i < n; ++i, x += dx) {
+        int64_t xi = x >> 32;
+        if(xi >= xMin && xi < xMax && y[i] >= yMin && y[i] < yMax)
+            Raw_drawPixel(p, g, xi, y[i]);
+    }
+}
+
+// Fixed point x pixel positions must stay in this range.
+#define FIXED_MAX  ((double) (((int64_t) 1) << 30))
+
+
+// Draw n uniformly spaced samples: the x values are x0, x0 + dx, x0 +
+// 2*dx, and so on, and y is an array of n samples of type "type".  This
+// is like calling pnPlot_drawPoint() for each sample, but y is not
+// converted to double one sample at a time before we map it, and x is
+// not mapped at all.  The x pixel positions are just added up.  For the
+// beam scope they are added up in fixed point, so the beam's pixel
+// columns come with no floating point at all; and the same for the
+// phosphor scope.
+//
+void pnPlot_drawSamples(struct PnPlot *p, double x0, double dx,
+        const void *y, enum PnSampleType type, size_t n) {
+
+    DASSERT(p);
+    DASSERT(y || !n);
+
+    if(!n) return;
+
+    double xa, xb, ya, yb;
+    GetMaps(p, &xa, &xb, &ya, &yb);
+
+    // The x pixel position of the first sample and the distance between
+    // samples in pixels.
+    const double px0 = x0 * xa + xb;
+    const double dpx = dx * xa;
+
+    // We can use fixed point if all the x pixel positions fit.
+    bool fixed = (p->drawMethod != PnDrawMethod_cairo &&
+            fabs(px0) < FIXED_MAX && fabs(px0 + n * dpx) < FIXED_MAX);
+    const double one = (double) (((int64_t) 1) << 32);
+    int64_t fx = 0, fdx = 0;
+    if(fixed) {
+        fx = llround(px0 * one);
+        fdx = llround(dpx * one);
+    }
+
+    double px[CHUNK], py[CHUNK];
+
+    for(size_t i = 0; i < n;) {
+        size_t num = (n - i < CHUNK)?(n - i):CHUNK;
+        MapSamples(py, y, type, i, num, ya, yb);
+        if(fixed) {
+            if(p->drawMethod == PnDrawMethod_beam)
+                Beam_drawSamples(p, fx, fdx, py, num);
+            else
+                Raw_drawSamples(p, fx, fdx, py, num);
+            fx += num * fdx;
+        } else {
+            for(size_t j = 0; j < num; ++j)
+                px[j] = px0 + (i + j) * dpx;
+            DrawPixels(p, px, py, num);
+        }
+        i += num;
+    }
+}
@@ -170,10 +170,16 @@ void pnPopup_hide(struct PnWidget *w) {
         win->wl_callback = 0;
     }
 
+    StopFrameTiming(win);
+
     // Make sure buffer is freed up and reset.
-    if(win->buffer.wl_buffer)
+    FreeSwapBuffers(win);
+    if(HaveBuffer(&win->buffer))
         FreeBuffer(&win->buffer);
 
+    win->headlessShown = false;
+    win->headlessFrame = false;
+
     DestroyPopup(win);
 
     // Call xdg_surface_destroy() before  wl_surface_destroy().
@@ -198,6 +204,21 @@ bool pnPopup_show(struct PnWidget *w, int32_t x, int32_t y) {
     ASSERT(w->type & POPUP);
     struct PnWindow *win = (void *) w;
 
+    if(d.headless) {
+        if(!win->headlessShown) {
+            // Like below, but with no Wayland objects to make.
+            _pnWidget_getAllocations(w);
+            DASSERT(w->allocation.width);
+            DASSERT(w->allocation.height);
+            win->popup.x = x;
+            win->popup.y = y;
+            win->headlessShown = true;
+            win->needDraw = true;
+        }
+        pnWidget_queueDraw(w, false);
+        return false; // success
+    }
+
     if(!win->popup.xdg_popup) {
         _pnWidget_getAllocations(w);
         DASSERT(w->allocation.width);
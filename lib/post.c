@@ -0,0 +1,251 @@
+// Posting function calls and widget draws from other threads.
+//
+// The libpanels widgets and windows are not thread safe; all of it must
+// be used from the main thread.  Threads that make data (like reading
+// an audio device or a DAQ) can use pnDisplay_post() to have a function
+// called in the main loop, or pnWidget_postDraw() to queue a widget
+// draw.  These two functions can be called from any thread.
+//
+// The posts go in a lock-free queue with many producers and one
+// consumer (the main loop), the intrusive MPSC (multiple producer single
+// consumer) queue of Dmitry Vyukov.  Producers wake the main loop by
+// writing to one eventfd(2), d.postFd, which is a main loop reader.  We
+// only write to it if it's not already written to and not read yet
+// (d.postWake), so lots of posts between main loop wake-ups make just
+// one system call.  pnWidget_postDraw() for a widget that is already
+// posted does nothing at all.
+//
+// Posts are always allocated, never a part of something that may be
+// freed while the post is in the queue.  We can't take a post out of
+// the middle of the queue, and a producer may be writing the "next" of
+// the last post in the queue at any time.  So when a widget with a draw
+// posted is destroyed we just clear the widget pointer in its post.
+//
+// The main loop reads the posts, so this needs pnDisplay_run().
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#include "../include/panels.h"
+#include "debug.h"
+#include "display.h"
+
+
+static inline void Push(struct PnPostQueue *q, struct PnPost *p) {
+
+    atomic_store(&p->next, 0);
+    struct PnPost *prev = atomic_exchange(&q->head, p);
+    // Between the exchange and this store the consumer can't get to "p"
+    // or the posts after it.  It gets them at the next wake-up.
+    atomic_store(&prev->next, p);
+}
+
+// Returns 0 if there are no posts that we can get now.
+//
+static inline struct PnPost *Pop(struct PnPostQueue *q) {
+
+    struct PnPost *tail = q->tail;
+    struct PnPost *next = atomic_load(&tail->next);
+
+    if(tail == &q->stub) {
+        if(!next) return 0;
+        q->tail = next;
+        tail = next;
+        next = atomic_load(&tail->next);
+    }
+
+    if(next) {
+        q->tail = next;
+        return tail;
+    }
+
+    if(tail != atomic_load(&q->head))
+        // A producer is in Push() now.
+        return 0;
+
+    // "tail" is the last one.  Put the stub back so we can take it.
+    Push(q, &q->stub);
+    next = atomic_load(&tail->next);
+    if(next) {
+        q->tail = next;
+        return tail;
+    }
+    return 0;
+}
+
+
+// Make the queue and eventfd when we make the display.  They must be
+// there before any thread can post.
+//
+bool InitPosts(void) {
+
+    struct PnPostQueue *q = &d.posts;
+    atomic_store(&q->stub.next, 0);
+    atomic_store(&q->head, &q->stub);
+    q->tail = &q->stub;
+    atomic_store(&d.postWake, false);
+    atomic_store(&d.numPosts, 0);
+
+    d.postFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(d.postFd < 0) {
+        ERROR("eventfd() failed");
+        return true;
+    }
+    return false;
+}
+
+void DestroyPosts(void) {
+
+    if(!d.posts.tail) return;
+
+    // Free the posts that were never called.
+    struct PnPost *p;
+    while((p = Pop(&d.posts)))
+        if(p->allocated) {
+            DZMEM(p, sizeof(*p));
+            free(p);
+        }
+
+    if(d.postFd >= 0)
+        close(d.postFd);
+    d.postFd = -1;
+    d.posts.tail = 0;
+}
+
+
+static inline void Wake(void) {
+
+    if(atomic_exchange(&d.postWake, true))
+        // It's already awake or will be.
+        return;
+
+    uint64_t one = 1;
+    if(write(d.postFd, &one, sizeof(one)) != sizeof(one))
+        // The count can't overflow, so this should not happen.
+        ERROR("write(%d,,) to eventfd failed", d.postFd);
+}
+
+
+// Call all the posted functions that we can get now.
+//
+void DoPosts(void) {
+
+    if(!d.posts.tail) return;
+
+    // We clear this before we look at the queue, so a post that we do not
+    // see now will write to the eventfd again.
+    atomic_store(&d.postWake, false);
+
+    struct PnPost *p;
+    while((p = Pop(&d.posts))) {
+        void (*func)(void *data) = p->func;
+        void *data = p->data;
+        if(p->allocated) {
+            DZMEM(p, sizeof(*p));
+            free(p);
+        }
+        func(data);
+        atomic_fetch_sub(&d.numPosts, 1);
+    }
+}
+
+// The d.postFd main loop reader.
+//
+int PostRead(int fd, void *userData) {
+
+    DASSERT(fd == d.postFd);
+
+    uint64_t count;
+    // It's non-blocking, and we do not care about the count.
+    if(read(fd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+
+    DoPosts();
+    return 0;
+}
+
+
+// This can be called from any thread.  func(data) is called in the main
+// loop (in the main thread) soon.  Posts from one thread are called in
+// the order they were posted.
+//
+// Returns true on failure, like if there is no display yet.
+//
+bool pnDisplay_post(void (*func)(void *data), void *data) {
+
+    DASSERT(func);
+
+    if(!HaveDisplay() || d.postFd < 0) {
+        ERROR("There is no display to post to");
+        return true;
+    }
+
+    struct PnPost *p = calloc(1, sizeof(*p));
+    ASSERT(p, "calloc(1,%zu) failed", sizeof(*p));
+    p->func = func;
+    p->data = data;
+    p->allocated = true;
+
+    atomic_fetch_add(&d.numPosts, 1);
+    Push(&d.posts, p);
+    Wake();
+    return false;
+}
+
+
+// w is 0 if the widget was destroyed after it was posted.
+//
+static void PostedDraw(struct PnWidget *w) {
+
+    if(!w) return;
+    // Clear it first, so a post while we queue the draw posts again.
+    atomic_store(&w->drawPost, 0);
+    pnWidget_queueDraw(w, false);
+}
+
+// "w" is being destroyed.  If it has a draw post in the post queue, the
+// post stays in the queue and we just make it forget the widget.  Only
+// the main thread calls the posts, so the post can't be being called
+// now.
+//
+void UnpostWidget(struct PnWidget *w) {
+
+    struct PnPost *p = atomic_exchange(&w->drawPost, 0);
+    if(p)
+        p->data = 0;
+}
+
+// Like pnWidget_queueDraw(w, false) but this can be called from any
+// thread.  The widget must not be destroyed while other threads can
+// call this for it.
+//
+void pnWidget_postDraw(struct PnWidget *w) {
+
+    DASSERT(w);
+
+    if(atomic_load(&w->drawPost))
+        // It's posted and not drawn yet.
+        return;
+
+    struct PnPost *p = calloc(1, sizeof(*p));
+    ASSERT(p, "calloc(1,%zu) failed", sizeof(*p));
+    p->func = (void (*)(void *)) PostedDraw;
+    p->data = w;
+    p->allocated = true;
+
+    struct PnPost *none = 0;
+    if(!atomic_compare_exchange_strong(&w->drawPost, &none, p)) {
+        // Another thread posted it just now.
+        DZMEM(p, sizeof(*p));
+        free(p);
+        return;
+    }
+
+    atomic_fetch_add(&d.numPosts, 1);
+    Push(&d.posts, p);
+    Wake();
+}
@@ -0,0 +1,408 @@
+// Frame timing and frame pacing.
+//
+// When the compositor has the wp_presentation protocol we get told when
+// the pixels of a frame were shown, and the refresh period of the
+// monitor it was shown on.  If it does not have wp_presentation we
+// estimate the refresh period from the time stamps in the wl_callback
+// (frame callback) events, which most compositors send at about the
+// time they show the last frame.
+//
+// With that we can do frame pacing: we hold off drawing queued widgets
+// until just before the compositor needs the next frame, so that things
+// like scope plots draw the newest samples that they have.  Without
+// pacing we draw as soon as we get the wl_callback, which can be most of
+// a refresh period before the frame is shown.
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wayland-client.h>
+#include "presentation-time-protocol.h"
+
+#include "../include/panels.h"
+#include "debug.h"
+#include "display.h"
+
+// If the deadline is less than this (in nanoseconds) from now we just
+// draw now.  Timers are not that precise.
+#define MIN_WAIT        (500000)
+// Time stamps farther apart than this are not from consecutive frames.
+#define MAX_REFRESH     (100000000)
+
+
+// The time now in nanoseconds from the same clock that wp_presentation
+// uses, which is CLOCK_MONOTONIC if we do not have wp_presentation.
+//
+uint64_t FrameClock(void) {
+
+    struct timespec t;
+    if(clock_gettime((clockid_t) d.presentationClock, &t)) {
+        ERROR("clock_gettime(%" PRIu32 ",) failed", d.presentationClock);
+        return 0;
+    }
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+// Change the time t from FrameClock() to CLOCK_MONOTONIC, which is the
+// clock users get times from.  The compositor picks the wp_presentation
+// clock and it does not have to be CLOCK_MONOTONIC, so we use the
+// difference between the two clocks now.  That's good to about a
+// microsecond.
+//
+uint64_t MonotonicTime(uint64_t t) {
+
+    if(!t || d.presentationClock == CLOCK_MONOTONIC)
+        return t;
+
+    struct timespec ts;
+    if(clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        ERROR("clock_gettime(CLOCK_MONOTONIC,) failed");
+        return 0;
+    }
+    uint64_t mono = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    uint64_t now = FrameClock();
+    if(!now) return 0; // error
+
+    if(now >= t) {
+        uint64_t ago = now - t;
+        return (mono > ago)?(mono - ago):0;
+    }
+    return mono + (t - now);
+}
+
+
+static void feedback_sync_output(void *data,
+        struct wp_presentation_feedback *feedback,
+        struct wl_output *output) {
+}
+
+static void feedback_presented(struct PnWindow *win,
+        struct wp_presentation_feedback *feedback,
+        uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+        uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo,
+        uint32_t flags) {
+
+    DASSERT(win);
+    DASSERT(win->feedback == feedback);
+
+    wp_presentation_feedback_destroy(feedback);
+    win->feedback = 0;
+
+    win->presentTime = ((((uint64_t) tv_sec_hi) << 32) | tv_sec_lo) *
+            1000000000ULL + tv_nsec;
+    // A zero refresh means the compositor does not know it (like with a
+    // variable refresh rate), so we keep what we had.
+    if(refresh)
+        win->refresh = refresh;
+    SetFrameLatency(win, win->feedbackFrame, win->presentTime);
+}
+
+static void feedback_discarded(struct PnWindow *win,
+        struct wp_presentation_feedback *feedback) {
+
+    DASSERT(win);
+    DASSERT(win->feedback == feedback);
+
+    // The frame was never shown; like if the window is covered or the
+    // next frame replaced it.
+    wp_presentation_feedback_destroy(feedback);
+    win->feedback = 0;
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+    .sync_output = feedback_sync_output,
+    .presented = (void *) feedback_presented,
+    .discarded = (void *) feedback_discarded
+};
+
+
+// Call this just before the wl_surface_commit() of a new frame.
+//
+// We only ask for feedback if we do not have any waiting.  That's about
+// every frame when we draw at most one frame per wl_callback, and we
+// just need the newest numbers anyway.
+//
+void AddFeedback(struct PnWindow *win) {
+
+    DASSERT(win);
+    DASSERT(win->wl_surface);
+
+    if(!d.wp_presentation || win->feedback) return;
+
+    win->feedback = wp_presentation_feedback(d.wp_presentation,
+            win->wl_surface);
+    if(!win->feedback) {
+        ERROR("wp_presentation_feedback() failed");
+        return;
+    }
+    if(wp_presentation_feedback_add_listener(win->feedback,
+                &feedback_listener, win)) {
+        ERROR("wp_presentation_feedback_add_listener() failed");
+        wp_presentation_feedback_destroy(win->feedback);
+        win->feedback = 0;
+        return;
+    }
+    // The frame record gets added right after this commit.
+    win->feedbackFrame = win->numFrames;
+}
+
+
+// Called from frame_new() with the time stamp, msec, from the wl_callback.
+//
+// The time stamp is in milliseconds with an undefined base, so we just
+// use the difference between consecutive ones to estimate the refresh
+// period.  The milliseconds are coarse, but averaging over a few frames
+// gets us close enough (like 16 and 17 milliseconds averages to about
+// 16.67 for 60 Hz).
+//
+void FrameCallbackTime(struct PnWindow *win, uint32_t msec) {
+
+    DASSERT(win);
+
+    win->callbackTime = FrameClock();
+
+    if(!d.wp_presentation && win->numFrames)
+        // This is about when the last frame was shown.
+        SetFrameLatency(win, win->numFrames - 1, win->callbackTime);
+
+    if(win->lastCallbackMSec) {
+        // This unsigned subtraction works when msec wraps.
+        uint64_t dt = (uint32_t) (msec - win->lastCallbackMSec) *
+                1000000ULL;
+        uint64_t r = win->callbackRefresh;
+
+        if(dt && dt < MAX_REFRESH) {
+            if(!r)
+                r = dt;
+            else if(dt < r + r/2)
+                // Else we did not draw for a frame or more, so dt is
+                // more than one refresh period.
+                r = (int64_t) r + ((int64_t) dt - (int64_t) r)/8;
+            win->callbackRefresh = r;
+        }
+    }
+    win->lastCallbackMSec = msec;
+}
+
+
+// Call after drawing a frame that started at startTime.
+//
+void AddDrawTime(struct PnWindow *win, uint64_t startTime) {
+
+    DASSERT(win);
+
+    uint64_t t = FrameClock() - startTime;
+
+    // A decaying maximum.  We would rather draw a little early than
+    // miss the frame.
+    if(t >= win->drawEstimate)
+        win->drawEstimate = t;
+    else
+        win->drawEstimate -= (win->drawEstimate - t)/16;
+}
+
+
+static inline uint64_t RefreshPeriod(const struct PnWindow *win) {
+    return win->refresh ? win->refresh : win->callbackRefresh;
+}
+
+// Returns the time when we should have drawn and committed the next
+// frame, or 0 if we don't know.
+//
+static uint64_t Deadline(const struct PnWindow *win, uint64_t now) {
+
+    uint64_t period = RefreshPeriod(win);
+    if(!period || !win->drawEstimate) return 0;
+
+    // We count refresh periods from the last time a frame was shown, if
+    // that was recent, else from the last wl_callback which is at about
+    // the start of the current refresh period.
+    uint64_t base = win->callbackTime;
+    if(win->presentTime && win->presentTime <= now &&
+            now - win->presentTime < 4 * period)
+        base = win->presentTime;
+    if(!base || base > now) return 0;
+
+    uint64_t next = base + ((now - base)/period + 1) * period;
+    uint64_t lead = win->pacingMargin + win->drawEstimate;
+
+    if(next < lead + now) return 0;
+    return next - lead;
+}
+
+
+static void SetTimer(uint64_t t, uint64_t now) {
+
+    DASSERT(d.pacingFd >= 0);
+
+    if(d.pacingTimeout && d.pacingTimeout <= t)
+        // It's set to go off before t.
+        return;
+
+    // We use a relative time because the presentation clock may not be
+    // a clock that timerfd can use.
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    uint64_t dt = t - now;
+    its.it_value.tv_sec = dt/1000000000ULL;
+    its.it_value.tv_nsec = dt%1000000000ULL;
+
+    if(timerfd_settime(d.pacingFd, 0, &its, 0)) {
+        ERROR("timerfd_settime() failed");
+        return;
+    }
+    d.pacingTimeout = t;
+}
+
+
+// Called from frame_new() after we got a wl_callback.  Returns true if
+// the drawing is put off until later, false if we should draw now.
+//
+// We just pace drawing from the draw queue.  Drawing the whole window
+// (from a resize or such) gets done right away.
+//
+bool PaceFrame(struct PnWindow *win) {
+
+    DASSERT(win);
+
+    if(!win->pacingMargin || d.pacingFd < 0 || win->needDraw ||
+            !win->dqWrite->first || d.headless || !d.mainLoopRunning)
+        // In headless mode the frames come from the synthetic clock,
+        // so there's nothing to wait for.  And without pnDisplay_run()
+        // (like with just pnDisplay_dispatch()) nothing reads the
+        // pacing timer.
+        return false;
+
+    uint64_t now = FrameClock();
+    uint64_t t = Deadline(win, now);
+    if(!t || t < now + MIN_WAIT)
+        return false;
+
+    win->pacingDeadline = t;
+    win->pacingPending = true;
+    SetTimer(t, now);
+    return true;
+}
+
+
+static void CheckWindow(struct PnWindow *win, uint64_t now,
+        uint64_t *next) {
+
+    if(!win->pacingPending) return;
+
+    if(!HaveSurface(win)) {
+        win->pacingPending = false;
+        return;
+    }
+
+    if(win->pacingDeadline <= now + MIN_WAIT) {
+        win->pacingPending = false;
+        _pnWindow_drawFrame(win);
+        return;
+    }
+
+    if(!*next || win->pacingDeadline < *next)
+        *next = win->pacingDeadline;
+}
+
+
+// The d.pacingFd main loop reader.
+//
+static int PacingTimeout(int fd, void *userData) {
+
+    DASSERT(fd == d.pacingFd);
+
+    uint64_t count;
+    // It's non-blocking, and we do not care about the count.
+    if(read(fd, &count, sizeof(count)) != sizeof(count))
+        // Not a real timeout.
+        return 0;
+
+    d.pacingTimeout = 0;
+
+    uint64_t now = FrameClock();
+    uint64_t next = 0;
+
+    for(struct PnWindow *win = d.windows; win; win = win->prev) {
+        CheckWindow(win, now, &next);
+        for(struct PnWindow *p = win->toplevel.popups; p; p = p->prev)
+            CheckWindow(p, now, &next);
+    }
+
+    if(next)
+        SetTimer(next, now);
+
+    return 0;
+}
+
+
+// Draw the windows that are waiting for the pacing timer now.  For
+// pnDisplay_dispatch(), after pnDisplay_run() returned with frames
+// still put off; else those windows would never draw again.
+//
+static void Expire(struct PnWindow *win) {
+
+    if(!win->pacingPending) return;
+
+    win->pacingPending = false;
+    if(HaveSurface(win))
+        _pnWindow_drawFrame(win);
+}
+
+void ExpireFramePacing(void) {
+
+    for(struct PnWindow *win = d.windows; win; win = win->prev) {
+        Expire(win);
+        for(struct PnWindow *p = win->toplevel.popups; p; p = p->prev)
+            Expire(p);
+    }
+}
+
+
+// Make the one timer that all windows use for frame pacing.  Returns
+// true on failure.
+//
+// This adds a reader to the main loop, so frame pacing needs
+// pnDisplay_run().  Frames are not paced without it.
+//
+bool InitFramePacing(void) {
+
+    if(d.pacingFd >= 0) return false;
+
+    d.pacingFd = timerfd_create(CLOCK_MONOTONIC,
+            TFD_NONBLOCK | TFD_CLOEXEC);
+    if(d.pacingFd < 0) {
+        ERROR("timerfd_create() failed");
+        return true;
+    }
+
+    if(pnDisplay_addReader(d.pacingFd, false, PacingTimeout, 0)) {
+        close(d.pacingFd);
+        d.pacingFd = -1;
+        return true;
+    }
+
+    return false;
+}
+
+
+// For when the window's wl_surface goes away.
+//
+void StopFrameTiming(struct PnWindow *win) {
+
+    DASSERT(win);
+
+    if(win->feedback) {
+        wp_presentation_feedback_destroy(win->feedback);
+        win->feedback = 0;
+    }
+    win->pacingPending = false;
+    win->presentTime = 0;
+    win->callbackTime = 0;
+    win->lastCallbackMSec = 0;
+}
@@ -0,0 +1,294 @@
+// A lock-free single producer single consumer (SPSC) ring buffer of
+// samples.
+//
+// This is for feeding a scope plot from a capture thread (reading an
+// audio device or a DAQ) at rates like 1 to 10 million samples per
+// second.  One thread writes samples and one thread (the main thread,
+// when it's attached to a plot) reads them.  There are no locks and no
+// system calls.
+//
+// The write and read indexes count samples forever (uint64_t, so they
+// do not wrap in our lifetime), and the number of samples in the ring
+// is write - read.  The number of samples in the ring buffer is a power
+// of 2 so we get the array index with a mask.  The producer keeps a copy
+// of the consumer's index that it reads again only when the ring looks
+// full, so the producer does not pull over the consumer's cache line for
+// every write.  The consumer reads at most once a draw frame, so it just
+// reads the producer's index each time.  The producer's and the
+// consumer's data are on different cache lines.
+//
+// The writer and reader can get pointers right into the ring memory
+// (pnRing_writeBegin() and pnRing_readBegin()), so they can read(2)
+// into it and plot out of it with no copies.  Because the ring wraps,
+// the readable samples come in two parts.
+//
+// If the ring is full the producer does not write over samples that the
+// reader may be reading.  pnRing_write() drops the newest samples and
+// counts them.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../include/panels.h"
+#include "debug.h"
+
+
+#define CACHE_LINE  (64)
+
+
+struct PnRing {
+
+    // The producer's cache line.
+    _Alignas(CACHE_LINE) _Atomic uint64_t writeIndex;
+    uint64_t readCache; // producer's old copy of readIndex
+    _Atomic uint64_t dropped;
+
+    // The consumer's cache line.
+    _Alignas(CACHE_LINE) _Atomic uint64_t readIndex;
+    uint64_t writeCache; // consumer's old copy of writeIndex
+    // The samples from readIndex to readStart are skipped at the next
+    // pnRing_readEnd().
+    uint64_t readStart;
+
+    // These do not change after pnRing_create().
+    _Alignas(CACHE_LINE) uint8_t *samples;
+    uint64_t size; // number of samples, a power of 2
+    uint64_t mask; // size - 1
+    size_t sampleSize; // in bytes
+    enum PnSampleType type;
+};
+
+
+static inline size_t SampleSize(enum PnSampleType type) {
+
+    switch(type) {
+        case PnSampleType_int16:
+            return sizeof(int16_t);
+        case PnSampleType_int32:
+            return sizeof(int32_t);
+        case PnSampleType_float:
+            return sizeof(float);
+        case PnSampleType_double:
+            return sizeof(double);
+    }
+    return 0;
+}
+
+
+// numSamples is rounded up to a power of 2.  Returns 0 on failure.
+//
+struct PnRing *pnRing_create(enum PnSampleType type, uint32_t numSamples) {
+
+    size_t sampleSize = SampleSize(type);
+    if(!sampleSize) {
+        ERROR("Bad sample type %d", type);
+        return 0;
+    }
+    if(numSamples > (((uint32_t) 1) << 31)) {
+        ERROR("Too many samples (%" PRIu32 ") for a ring", numSamples);
+        return 0;
+    }
+
+    // At least a cache line full of samples.
+    uint64_t size = CACHE_LINE;
+    while(size < numSamples)
+        size <<= 1;
+
+    struct PnRing *r = aligned_alloc(CACHE_LINE, sizeof(*r));
+    ASSERT(r, "aligned_alloc(%d,%zu) failed", CACHE_LINE, sizeof(*r));
+    memset(r, 0, sizeof(*r));
+
+    r->samples = aligned_alloc(CACHE_LINE, size * sampleSize);
+    ASSERT(r->samples, "aligned_alloc(%d,%" PRIu64 ") failed",
+            CACHE_LINE, size * sampleSize);
+    r->size = size;
+    r->mask = size - 1;
+    r->sampleSize = sampleSize;
+    r->type = type;
+    atomic_store(&r->writeIndex, 0);
+    atomic_store(&r->readIndex, 0);
+    atomic_store(&r->dropped, 0);
+
+    return r;
+}
+
+// Neither thread may be using the ring when it's destroyed.
+//
+void pnRing_destroy(struct PnRing *r) {
+
+    DASSERT(r);
+    DASSERT(r->samples);
+
+    DZMEM(r->samples, r->size * r->sampleSize);
+    free(r->samples);
+    DZMEM(r, sizeof(*r));
+    free(r);
+}
+
+
+enum PnSampleType pnRing_getSampleType(const struct PnRing *r) {
+
+    DASSERT(r);
+    return r->type;
+}
+
+
+// Producer functions.  Only one thread may call these.
+
+// Get a pointer to where the next samples go, and the number of samples
+// that can go there in *num.  *num may be less than the room in the ring
+// when the room wraps past the end of the ring memory; write those
+// samples, call pnRing_writeEnd(), and call this again to get the rest.
+//
+// Returns 0 with *num = 0 if the ring is full.
+//
+void *pnRing_writeBegin(struct PnRing *r, uint32_t *num) {
+
+    DASSERT(r);
+    DASSERT(num);
+
+    uint64_t w = atomic_load_explicit(&r->writeIndex, memory_order_relaxed);
+    uint64_t room = r->size - (w - r->readCache);
+
+    if(!room) {
+        // Now we look at the consumer's cache line.
+        r->readCache = atomic_load_explicit(&r->readIndex,
+                memory_order_acquire);
+        room = r->size - (w - r->readCache);
+        if(!room) {
+            *num = 0;
+            return 0;
+        }
+    }
+
+    uint64_t i = w & r->mask;
+    if(room > r->size - i)
+        // Up to the end of the ring memory.
+        room = r->size - i;
+    *num = room;
+    return r->samples + i * r->sampleSize;
+}
+
+// Publish num samples written to the pointer from pnRing_writeBegin().
+//
+void pnRing_writeEnd(struct PnRing *r, uint32_t num) {
+
+    DASSERT(r);
+
+    uint64_t w = atomic_load_explicit(&r->writeIndex, memory_order_relaxed);
+    DASSERT(w + num - r->readCache <= r->size);
+    atomic_store_explicit(&r->writeIndex, w + num, memory_order_release);
+}
+
+// Copy num samples into the ring.  Returns the number of samples written.
+// The samples that do not fit are dropped and counted.
+//
+uint32_t pnRing_write(struct PnRing *r, const void *samples, uint32_t num) {
+
+    DASSERT(r);
+    DASSERT(samples || !num);
+
+    const uint8_t *s = samples;
+    uint32_t written = 0;
+
+    while(written < num) {
+        uint32_t n;
+        void *to = pnRing_writeBegin(r, &n);
+        if(!n) {
+            atomic_fetch_add_explicit(&r->dropped, num - written,
+                    memory_order_relaxed);
+            break;
+        }
+        if(n > num - written)
+            n = num - written;
+        memcpy(to, s, n * r->sampleSize);
+        pnRing_writeEnd(r, n);
+        s += n * r->sampleSize;
+        written += n;
+    }
+
+    return written;
+}
+
+
+// Consumer functions.  Only one thread may call these.
+
+// Get the samples that are in the ring now, oldest first, in one or two
+// parts: *first is *numFirst samples and *second is *numSecond samples
+// that come after them.  If newest is not 0 we skip all but the newest
+// "newest" samples, and the skipped samples are gone at the
+// pnRing_readEnd() call.
+//
+// The samples stay put (the producer can't write over them) until
+// pnRing_readEnd() is called.
+//
+// Returns the number of samples, *numFirst + *numSecond.
+//
+uint32_t pnRing_readBegin(struct PnRing *r, uint32_t newest,
+        const void **first, uint32_t *numFirst,
+        const void **second, uint32_t *numSecond) {
+
+    DASSERT(r);
+    DASSERT(first);
+    DASSERT(numFirst);
+    DASSERT(second);
+    DASSERT(numSecond);
+
+    uint64_t rd = atomic_load_explicit(&r->readIndex, memory_order_relaxed);
+
+    // We do not wait for samples, so we always look at the producer's
+    // index here.
+    r->writeCache = atomic_load_explicit(&r->writeIndex,
+            memory_order_acquire);
+    uint64_t num = r->writeCache - rd;
+    DASSERT(num <= r->size);
+
+    if(newest && num > newest) {
+        rd += num - newest;
+        num = newest;
+    }
+    r->readStart = rd;
+
+    uint64_t i = rd & r->mask;
+    *first = r->samples + i * r->sampleSize;
+
+    if(num > r->size - i) {
+        // It wraps.
+        *numFirst = r->size - i;
+        *numSecond = num - *numFirst;
+        *second = r->samples;
+    } else {
+        *numFirst = num;
+        *numSecond = 0;
+        *second = 0;
+    }
+
+    return num;
+}
+
+// Free num samples, from the start of the samples we got from the last
+// pnRing_readBegin(), plus the samples it skipped, so the producer can
+// write there.
+//
+void pnRing_readEnd(struct PnRing *r, uint32_t num) {
+
+    DASSERT(r);
+    DASSERT(r->readStart + num <= r->writeCache);
+
+    atomic_store_explicit(&r->readIndex, r->readStart + num,
+            memory_order_release);
+}
+
+
+// The number of samples that pnRing_write() dropped because the ring was
+// full.  This can be called from any thread.
+//
+uint64_t pnRing_getDropped(const struct PnRing *r) {
+
+    DASSERT(r);
+    return atomic_load_explicit(&r->dropped, memory_order_relaxed);
+}
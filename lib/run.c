@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-client.h>
 #include <linux/input-event-codes.h>
 #include "xdg-shell-protocol.h"
@@ -26,9 +27,11 @@
 #include "mainLoop.h"
 
 
+// Returns 0 in headless mode.
+//
 struct wl_display *pnDisplay_getWaylandDisplay(void) {
 
-    if(!d.wl_display) {
+    if(!HaveDisplay()) {
         if(_pnDisplay_create()) {
             DASSERT(0);
             return 0;
@@ -40,7 +43,7 @@ struct wl_display *pnDisplay_getWaylandDisplay(void) {
 
 static inline bool InitDisplay(void) {
 
-    if(!d.wl_display) {
+    if(!HaveDisplay()) {
         if(_pnDisplay_create()) {
             DASSERT(0);
             return true;
@@ -53,6 +56,32 @@ static inline bool InitDisplay(void) {
 // we can have this, "wl_fd", as a global static variable.
 static int wl_fd = -1;
 
+// The main loop writer for the Wayland display fd (a dup of it) that we
+// have just while there are requests that wl_display_flush() could not
+// write.
+//
+// Returns 0 to keep waiting to write
+// Returns 1 to remove the writer, when it's all written or on error.
+// PreDispatch() will see the error at its next wl_display_flush().
+//
+static int Wayland_Write(int fd, void *userData) {
+
+    DASSERT(fd == d.flushFd);
+    DASSERT(d.flushPending);
+    DASSERT(d.wl_display);
+
+    errno = 0;
+    if(wl_display_flush(d.wl_display) == -1) {
+        if(errno == EAGAIN)
+            return 0;
+        d.flushPending = false;
+        return 1;
+    }
+
+    d.flushPending = false;
+    return 1; // all written
+}
+
 // This function may need to have some ASSERT() calls replaced with
 // an error check and a return.
 //
@@ -69,12 +98,20 @@ static int PreDispatch(void *userData) {
     DASSERT(wl_fd >= 0);
     DASSERT(d.mainLoop);
 
-    if(wl_display_dispatch_pending(d.wl_display) < 0) {
+    d.dispatching = true;
+    int ret = wl_display_dispatch_pending(d.wl_display);
+    d.dispatching = false;
+    FlushPointerMotion();
+    if(ret < 0) {
         // TODO: Handle failure modes.
         ERROR("wl_display_dispatch_pending() failed");
         return -1; // fail
     }
 
+    if(d.flushPending)
+        // Wayland_Write() will flush when the compositor takes more.
+        return 0;
+
     // See
     // https://www.systutorials.com/docs/linux/man/3-wl_display_flush/
     //
@@ -84,40 +121,29 @@ static int PreDispatch(void *userData) {
     // wl_display_flush(d) Flushes write commands to compositor.
     errno = 0;
 
-    int ret = wl_display_flush(d.wl_display);
-
-    while(ret == -1 && errno == EAGAIN) {
-        // Keep trying.
-        fd_set wfds;
-        FD_ZERO(&wfds);
-        FD_SET(wl_fd, &wfds);
-        // This may never happen, so lets see it if it does.
-        NOTICE("waiting to flush wayland display");
-        ret = select(wl_fd+1, 0, &wfds, 0, 0);
-        switch(ret) {
-            case -1:
-                ERROR("select failed");
-                return -1;
-            case 1:
-                DASSERT(FD_ISSET(wl_fd, &wfds));
-                if(!FD_ISSET(wl_fd, &wfds)) {
-                    ERROR("select failed to set fd=%d", wl_fd);
-                    return -1;
-                }
-                break;
-            default:
-                DASSERT(0, "select() returned %d", ret);
-                ERROR("select() returned %d", ret);
-                return -1;
-        }
+    if(wl_display_flush(d.wl_display) != -1)
+        return 0; // success.
 
-        errno = 0;
-        ret = wl_display_flush(d.wl_display);
-    }
-    if(ret == -1) {
+    if(errno != EAGAIN) {
         ERROR("wl_display_flush() failed");
         return -1;
     }
+
+    // The compositor is not reading fast enough.  We do not wait for it
+    // here (in select(2) or the like), because that would stop all the
+    // other main loop readers too, like the ones reading sample data.
+    // The main loop calls Wayland_Write() when we can write more.
+    if(d.flushFd < 0) {
+        d.flushFd = dup(wl_fd);
+        if(d.flushFd < 0) {
+            ERROR("dup(%d) failed", wl_fd);
+            return -1;
+        }
+    }
+    if(pnMainLoop_addWriter(d.mainLoop, d.flushFd, Wayland_Write, 0))
+        return -1;
+    d.flushPending = true;
+
     return 0; // success.
 }
 
@@ -134,8 +160,13 @@ static int Wayland_Read(int fd, void *userData) {
         return 2; // 2 -> stop all callbacks
     }
 
-    if(wl_display_dispatch(d.wl_display) == -1 ||
-            !pnDisplay_haveWindow()) {
+    d.dispatching = true;
+    int ret = wl_display_dispatch(d.wl_display);
+    d.dispatching = false;
+    // Act on the last of the pointer motion events we just read.
+    FlushPointerMotion();
+
+    if(ret == -1 || !pnDisplay_haveWindow()) {
         DSPEW("Cleaning up wl_display d.wl_display=%p "
                 "pnDisplay_haveWindow()=%d",
                 d.wl_display, pnDisplay_haveWindow());
@@ -153,16 +184,29 @@ static inline bool Init(void) {
 
     if(InitDisplay()) return true; // error
 
-    if(!d.mainLoop && !(d.mainLoop = pnMainLoop_create())) {
+    if(d.mainLoop)
+        // We did the rest already.
+        return false;
+
+    if(!(d.mainLoop = pnMainLoop_create())) {
         DASSERT(0);
         return true;
     }
 
-    wl_fd = wl_display_get_fd(d.wl_display);
-    ASSERT(wl_fd >= 0);
+    if(!d.headless) {
+        // In headless mode there is no Wayland display fd to read.
+        wl_fd = wl_display_get_fd(d.wl_display);
+        ASSERT(wl_fd >= 0);
+
+        // This must be the first reader; see PostDispatch().
+        if(pnMainLoop_addReader(d.mainLoop, wl_fd, false/*edge_trigger*/,
+                Wayland_Read, 0/*userData*/))
+            return true; // error and fail
+    }
 
-    if(pnMainLoop_addReader(d.mainLoop, wl_fd, false/*edge_trigger*/,
-            Wayland_Read, 0/*userData*/))
+    // The posts from other threads, see post.c.
+    if(pnMainLoop_addReader(d.mainLoop, d.postFd, false/*edge_trigger*/,
+            PostRead, 0/*userData*/))
         return true; // error and fail
 
     return false; // success.
@@ -170,7 +214,7 @@ static inline bool Init(void) {
 
 
 bool pnDisplay_haveWindow(void) {
-    return (d.wl_display && d.windows)?true:false;
+    return (HaveDisplay() && d.windows)?true:false;
 }
 
 
@@ -178,12 +222,28 @@ bool pnDisplay_haveWindow(void) {
 //
 // Return true if we can keep running.
 //
+// In headless mode this does not block.  It moves the synthetic clock
+// one frame ahead and draws the windows that need drawing.
+//
 bool pnDisplay_dispatch(void) {
 
     if(InitDisplay()) return false;
 
-    if(wl_display_dispatch(d.wl_display) != -1 &&
-            d.windows/*we have at least one window*/)
+    if(d.headless) {
+        HeadlessDispatch();
+        return (d.windows)?true:false;
+    }
+
+    // Frames that pnDisplay_run() put off for frame pacing would wait
+    // for a timer that we do not read here.
+    ExpireFramePacing();
+
+    d.dispatching = true;
+    int ret = wl_display_dispatch(d.wl_display);
+    d.dispatching = false;
+    FlushPointerMotion();
+
+    if(ret != -1 && d.windows/*we have at least one window*/)
         // We can keep going.
         return true;
 
@@ -215,7 +275,10 @@ static inline bool EpollRun(void) {
     DASSERT(wl_fd == d.mainLoop->readers->fd);
 
 #if 1
-    return pnMainLoop_run(d.mainLoop, PreDispatch, 0, PostDispatch, 0);
+    d.mainLoopRunning = true;
+    bool ret = pnMainLoop_run(d.mainLoop, PreDispatch, 0, PostDispatch, 0);
+    d.mainLoopRunning = false;
+    return ret;
 #else
     // This is the same as calling pnMainLoop_run():
     //
@@ -245,6 +308,47 @@ static inline bool EpollRun(void) {
     return false; // success
 }
 
+// Are there main loop readers that can give us more to draw?  The
+// d.postFd reader is always there, so it only counts when there are
+// posts that are not called yet; else we would wait forever after the
+// posting threads are done.
+//
+static inline bool HaveOtherReaders(void) {
+
+    if(atomic_load(&d.numPosts)) return true;
+    for(struct PnFD *f = d.mainLoop->readers; f; f = f->next)
+        if(f->fd != d.postFd)
+            return true;
+    return false;
+}
+
+// Headless pnDisplay_run().  We draw frames as fast as we can while
+// there are windows that need drawing.  When there are none we wait
+// for the main loop readers and timers, if there are any, which may
+// queue more drawing.  With none nothing can change, so we return.
+//
+// Return true on failure.
+//
+static bool HeadlessRun(void) {
+
+    DASSERT(d.headless);
+
+    while(d.windows) {
+        if(HeadlessDispatch()) {
+            // We are not waiting, so see if any timers are due.
+            if(d.mainLoop)
+                DoTimers(d.mainLoop);
+            continue;
+        }
+        if(!d.mainLoop || (!HaveOtherReaders() &&
+                    !d.mainLoop->writers && !d.mainLoop->timers))
+            break;
+        if(pnMainLoop_wait(d.mainLoop))
+            return true;
+    }
+    return false;
+}
+
 // Return true on failure.
 //
 // This is a little like gtk_main() except that: we can call it more than
@@ -253,16 +357,12 @@ static inline bool EpollRun(void) {
 //
 bool pnDisplay_run() {
 
-    if(InitDisplay()) return true; // error case.
+    // We always use the main loop now, because other threads can post
+    // to it (see post.c) at any time.
+    if(Init()) return true; // error case.
 
-    if(!d.mainLoop) {
-        while(wl_display_dispatch(d.wl_display) != -1) {
-            if(!d.windows/*we do not have at least one window*/)
-                // We can't keep going.
-                return false;
-        }
-        return false;
-    }
+    if(d.headless)
+        return HeadlessRun();
 
     return EpollRun();
 }
@@ -298,3 +398,32 @@ bool pnDisplay_removeReader(int fd) {
         pnMainLoop_removeReader(d.mainLoop, fd);
 }
 
+
+// Returns 0 on failure.
+//
+struct PnTimer *pnDisplay_addTimer(uint64_t timeout,
+        uint64_t period, uint64_t slack,
+        int (*callback)(struct PnTimer *timer, void *userData),
+        void *userData) {
+
+    DASSERT(callback);
+
+    if(Init()) return 0;
+
+    return pnMainLoop_addTimer(d.mainLoop, timeout, period, slack,
+            callback, userData);
+}
+
+// Return true on failure.
+//
+bool pnDisplay_removeTimer(struct PnTimer *timer) {
+
+    DASSERT(timer);
+
+    if(!d.mainLoop) {
+        ERROR("No mainloop present");
+        return true;
+    }
+
+    return pnMainLoop_removeTimer(d.mainLoop, timer);
+}
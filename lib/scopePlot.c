@@ -107,8 +107,10 @@ bool ScopeDrawAction(struct PnGraph *g, struct PnCallback *callback,
 
     // userCallback() may call the pnGraph_drawPoint() function many
     // times.
+    PlotRingBegin(p);
     bool ret = userCallback(&g->widget, p, userData,
             g->xMin, g->xMax, g->yMin, g->yMax);
+    PlotRingEnd(p);
 
     const double hw = p->pointSize;
     const double w = 2.0*hw;
@@ -1,12 +1,23 @@
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
+#include <wayland-client.h>
+
+#include "../include/panels.h"
 
 #include "debug.h"
+#include "display.h"
+
+
+// Buffers at least this large get madvise(MADV_HUGEPAGE) with
+// PnShm_hugePages.  It's the x86_64 huge page size.
+#define BIG_BUFFER  (2*1024*1024)
 
 static inline bool set_cloexec(int fd) {
 
@@ -63,6 +74,24 @@ static int anonymous_shm_open(void) {
     return -1;
 }
 
+// Returns a file descriptor from memfd_create(2), or -1 if we can't.
+//
+static int memfd_open(void) {
+
+    // If it failed once it will keep failing; like if the kernel is too
+    // old.  No need to keep spewing about it.
+    static bool failed = false;
+
+    if(failed) return -1;
+
+    int fd = memfd_create("panels", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0) {
+        NOTICE("memfd_create() failed");
+        failed = true;
+    }
+    return fd;
+}
+
 static inline int getFileFromEnv(void) {
 
     const char *env = getenv("XDG_RUNTIME_DIR");
@@ -99,7 +128,17 @@ static inline int getFileFromEnv(void) {
 //
 int create_shm_file(size_t size) {
 
-    int fd = getFileFromEnv();
+    int fd = -1;
+    bool memfd = false;
+
+    // memfd_create(2) does not need a file system, or a name that could
+    // collide with another process.
+    if(!(d.shmFlags & PnShm_file)) {
+        fd = memfd_open();
+        memfd = (fd > -1);
+    }
+    if(fd <= -1)
+        fd = getFileFromEnv();
     if(fd <= -1)
         fd = anonymous_shm_open();
     if(fd <= -1)
@@ -111,5 +150,68 @@ int create_shm_file(size_t size) {
 	return -1;
     }
 
+    // The file can grow (see ResizeBuffer() in buffer.c) but we never
+    // shrink it, so we let the compositor know that it can't shrink; so
+    // it does not need to guard against SIGBUS when it reads it.
+    if(memfd && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == -1)
+        WARN("fcntl(%d, F_ADD_SEALS, F_SEAL_SHRINK) failed", fd);
+
     return fd;
 }
+
+// mmap(2) the file from create_shm_file() using the d.shmFlags options.
+//
+// Returns MAP_FAILED on failure, like mmap(2).
+//
+void *map_shm_file(int fd, size_t size) {
+
+    int flags = MAP_SHARED;
+    bool huge = ((d.shmFlags & PnShm_hugePages) && size >= BIG_BUFFER);
+
+    // If we are asking for huge pages we need to madvise() before the
+    // pages are faulted in, so we populate after that.
+    if((d.shmFlags & PnShm_populate) && !huge)
+        flags |= MAP_POPULATE;
+
+    void *pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if(pixels == MAP_FAILED || !huge)
+        return pixels;
+
+    if(madvise(pixels, size, MADV_HUGEPAGE))
+        // It's just advice.  The kernel may not be configured for it.
+        INFO("madvise(,%zu,MADV_HUGEPAGE) failed", size);
+
+#ifdef MADV_POPULATE_WRITE
+    if((d.shmFlags & PnShm_populate) &&
+            madvise(pixels, size, MADV_POPULATE_WRITE))
+        INFO("madvise(,%zu,MADV_POPULATE_WRITE) failed", size);
+#endif
+
+    return pixels;
+}
+
+// Parse the PN_SHM environment variable; like PN_SHM=populate,hugepage
+//
+uint32_t GetShmFlagsFromEnv(void) {
+
+    const char *env = getenv("PN_SHM");
+    if(!env || !env[0]) return 0;
+
+    uint32_t flags = 0;
+
+    while(*env) {
+        size_t len = strcspn(env, ",");
+        if(len == 4 && !strncmp(env, "file", 4))
+            flags |= PnShm_file;
+        else if(len == 8 && !strncmp(env, "populate", 8))
+            flags |= PnShm_populate;
+        else if(len == 8 && !strncmp(env, "hugepage", 8))
+            flags |= PnShm_hugePages;
+        else if(len)
+            WARN("Unknown PN_SHM option \"%.*s\"", (int) len, env);
+        env += len;
+        if(*env) ++env; // skip ','
+    }
+
+    return flags;
+}
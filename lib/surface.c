@@ -344,6 +344,13 @@ void AddChildSurface(struct PnWidget *parent, struct PnWidget *s,
         AddChildSurfaceGrid(parent, s, column, row, cSpan, rSpan);
 
     s->window = parent->window;
+    if(s->window) {
+        // The natural sizes of the widgets above are wrong now.
+        s->window->naturalValid = false;
+        // And "s" may not be opaque.
+        s->window->checkOpaque = true;
+    }
+    InvalidateFindIndex(s->window);
 }
     
 static inline
@@ -419,6 +426,11 @@ void RemoveChildSurface(struct PnWidget *parent, struct PnWidget *s) {
         RemoveChildSurfaceList(parent, s);
     else
         RemoveChildSurfaceGrid(parent, s);
+
+    if(parent->window)
+        parent->window->naturalValid = false;
+    // "s" may be going away, so we can't keep it in the find index.
+    InvalidateFindIndex(parent->window);
 }
 
 
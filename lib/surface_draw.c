@@ -14,15 +14,44 @@
 #include "../include/panels_drawingUtils.h"
 
 
+#ifdef WITH_CAIRO
+// Clip the widget's cairo drawing to the rectangles from
+// pnWidget_queueDrawRect().  The cairo surface is just over the widget,
+// so we move the rectangles from window coordinates.
+//
+static inline void ClipDirty(const struct PnWidget *s) {
+
+    DASSERT(s->numDirty);
+    DASSERT(s->cr);
+
+    cairo_save(s->cr);
+    for(uint32_t i = 0; i < s->numDirty; ++i) {
+        const struct PnAllocation *r = s->dirty + i;
+        cairo_rectangle(s->cr,
+                (double) r->x - s->allocation.x,
+                (double) r->y - s->allocation.y,
+                r->width, r->height);
+    }
+    cairo_clip(s->cr);
+}
+#endif
+
+
 // This function calls itself.
 //
-void pnSurface_draw(const struct PnWidget *s,
+// Returns the number of widgets drawn, for the frame statistics.  We
+// don't count them in the window, because this may be called from more
+// than one thread at a time; see drawWorkers.c.
+//
+uint32_t pnSurface_draw(const struct PnWidget *s,
         const struct PnBuffer *buffer, bool config) {
 
     DASSERT(s);
     DASSERT(!s->culled);
     DASSERT(s->window);
 
+    uint32_t n = 1;
+
     if(config && s->config)
         s->config((void *) s,
                 buffer->pixels +
@@ -35,11 +64,22 @@ void pnSurface_draw(const struct PnWidget *s,
 #ifdef WITH_CAIRO
     if(s->cairoDraw) {
         DASSERT(s->cr);
-        if(s->cairoDraw((void *) s, s->cr, s->cairoDrawData) == 1)
+        // The callback may queue "s" again, and that can change
+        // s->numDirty.
+        bool clipped = s->numDirty;
+        if(clipped)
+            ClipDirty(s);
+        int ret = s->cairoDraw((void *) s, s->cr, s->cairoDrawData);
+        if(clipped)
+            cairo_restore(s->cr);
+        if(ret == 1)
             pnWidget_queueDraw((void *) s, false/*allocate*/);
     } else if(!s->draw) {
         DASSERT(s->cr);
         uint32_t c = s->backgroundColor;
+        bool clipped = s->numDirty;
+        if(clipped)
+            ClipDirty(s);
         cairo_set_source_rgba(s->cr,
                ((0x00FF0000 & c) >> 16)/255.0, // R
                ((0x0000FF00 & c) >> 8)/255.0,  // G
@@ -47,14 +87,25 @@ void pnSurface_draw(const struct PnWidget *s,
                ((0xFF000000 & c) >> 24)/255.0  // A
         );
         cairo_paint(s->cr);
+        if(clipped)
+            cairo_restore(s->cr);
     }
 #else // without Cairo
-    if(!s->draw)
-        pn_drawFilledRectangle(buffer->pixels,
-                s->allocation.x, s->allocation.y, 
-                s->allocation.width, s->allocation.height,
-                buffer->stride,
-                s->backgroundColor /*color in ARGB*/);
+    if(!s->draw) {
+        if(s->numDirty)
+            for(uint32_t i = 0; i < s->numDirty; ++i)
+                pn_drawFilledRectangle(buffer->pixels,
+                        s->dirty[i].x, s->dirty[i].y,
+                        s->dirty[i].width, s->dirty[i].height,
+                        buffer->stride,
+                        s->backgroundColor /*color in ARGB*/);
+        else
+            pn_drawFilledRectangle(buffer->pixels,
+                    s->allocation.x, s->allocation.y, 
+                    s->allocation.width, s->allocation.height,
+                    buffer->stride,
+                    s->backgroundColor /*color in ARGB*/);
+    }
 #endif
     else
         if(s->draw((void *) s,
@@ -81,15 +132,15 @@ void pnSurface_draw(const struct PnWidget *s,
             for(struct PnWidget *c = s->l.firstChild; c;
                     c = c->pl.nextSibling) {
                 if(!c->culled)
-                    pnSurface_draw(c, buffer, config);
+                    n += pnSurface_draw(c, buffer, config);
             }
-            return;
+            break;
 
         case PnLayout_Grid:
         {
             if(!s->g.grid)
                 // No children yet.
-                return;
+                break;
             // s is a grid container.
             struct PnWidget ***child = s->g.grid->child;
             DASSERT(child);
@@ -103,9 +154,11 @@ void pnSurface_draw(const struct PnWidget *s,
                     // span N and/or column span N; that is adjacent cells
                     // that share the same widget.
                     if(IsUpperLeftCell(c, child, x, y))
-                        pnSurface_draw(c, buffer, config);
+                        n += pnSurface_draw(c, buffer, config);
                 }
-            return;
+            break;
         }
     }
+
+    return n;
 }
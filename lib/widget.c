@@ -192,6 +192,7 @@ void pnWidget_destroy(struct PnWidget *w) {
     // (w) take care to not refer to it.  Like if this widget (w) had
     // focus, for example.
     RemoveSurfaceFromDisplay((void *) w);
+    UnpostWidget(w);
 
     while(w->destroys) {
         struct PnWidgetDestroy *destroy = w->destroys;
@@ -241,10 +242,46 @@ void pnWidget_show(struct PnWidget *widget, bool show) {
         return;
 
     widget->hidden = !show;
+    InvalidateFindIndex(widget->window);
     // This change may change the size of the window and many of the
-    // widgets in the window.
+    // widgets in the window.  Usually it just moves the widgets near it,
+    // and RelayoutChanged() can queue just them.
 
-    widget->window->widget.needAllocate = true; 
+    if(RelayoutChanged(widget))
+        widget->window->widget.needAllocate = true;
+}
+
+void pnWidget_setSize(struct PnWidget *widget, uint32_t w, uint32_t h) {
+
+    DASSERT(widget);
+    DASSERT(widget->window);
+    ASSERT(!(widget->type & (TOPLEVEL | POPUP)));
+
+    // Like in _pnWidget_createFull(), a leaf widget needs non-zero width
+    // and height.
+    if(widget->layout == PnLayout_None) {
+        if(w == 0)
+            w = PN_MIN_WIDGET_WIDTH;
+        if(h == 0)
+            h = PN_MIN_WIDGET_HEIGHT;
+    }
+
+    if(widget->reqWidth == w && widget->reqHeight == h)
+        // No change.
+        return;
+
+    widget->reqWidth = w;
+    widget->reqHeight = h;
+
+    if(widget->hidden)
+        // We'll get to it when it's shown.
+        return;
+
+    InvalidateFindIndex(widget->window);
+    // Like with pnWidget_show(), this usually just moves the widgets near
+    // it.
+    if(RelayoutChanged(widget))
+        widget->window->widget.needAllocate = true;
 }
 
 void pnWidget_addChild(struct PnWidget *parent,
@@ -59,6 +59,9 @@ void pnWidget_setBackgroundColor(
         struct PnWidget *w, uint32_t argbColor, bool recurse) {
     DASSERT(w);
     w->backgroundColor = argbColor;
+    if(w->window)
+        // The window's pixel format may change.
+        w->window->checkOpaque = true;
     if(!recurse) return;
     // Change the children's colors.
     if(w->layout == PnLayout_Grid) {
@@ -171,6 +174,17 @@ void pnWidget_setMotion(struct PnWidget *w,
     }
 }
 
+// By default, of the pointer motion events that we read from the
+// compositor at one time, we only call the motion callbacks for the
+// last one.  With "all" set we call them for every motion event, for
+// widgets that need every position, like for drawing with the pointer.
+//
+void pnWidget_setAllMotion(struct PnWidget *w, bool all) {
+
+    DASSERT(w);
+    w->allMotion = all;
+}
+
 void pnWidget_setAxis(struct PnWidget *w,
         bool (*axis)(struct PnWidget *w,
             uint32_t time, uint32_t which, double value,
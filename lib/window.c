@@ -17,7 +17,7 @@ static
 void DrawAll(struct PnWindow *win, struct PnBuffer *buffer) {
 
     DASSERT(win);
-    DASSERT(win->wl_surface);
+    DASSERT(HaveSurface(win));
     DASSERT(win->needDraw || buffer);
     DASSERT(win->dqRead);
     DASSERT(win->dqWrite);
@@ -27,6 +27,8 @@ void DrawAll(struct PnWindow *win, struct PnBuffer *buffer) {
     DASSERT(!win->dqRead->last);
 
     struct PnWidget *w = &win->widget;
+    // For the frame statistics.
+    uint64_t t0 = FrameClock();
 
     if(w->needAllocate) {
         struct PnAllocation *a = &w->allocation;
@@ -39,6 +41,8 @@ void DrawAll(struct PnWindow *win, struct PnBuffer *buffer) {
         _pnWidget_getAllocations(w);
     }
 
+    uint64_t layout = FrameClock() - t0;
+
     // GetNextBuffer() can reallocate the buffer if the width or height
     // passed here is different from the width and height of the buffer it
     // is getting.
@@ -50,7 +54,10 @@ void DrawAll(struct PnWindow *win, struct PnBuffer *buffer) {
         // I think this is okay.  The wayland compositor is just a little
         // busy now.  I think we will get this done later from a wl_buffer
         // release event callback; see buffer.c.
-        if(w->needAllocate)
+        //
+        // If we are waiting for a swapchain buffer we keep needAllocate
+        // so the config() callbacks get called when we do draw.
+        if(w->needAllocate && !win->waitingForRelease)
             w->needAllocate = false;
         return;
     }
@@ -73,19 +80,28 @@ void DrawAll(struct PnWindow *win, struct PnBuffer *buffer) {
     DASSERT(w->allocation.width == buffer->width);
     DASSERT(w->allocation.height == buffer->height);
 
-    pnSurface_draw(w, buffer, w->needAllocate);
+    t0 = FrameClock();
+    win->widgetsDrawn += pnSurface_draw(w, buffer, w->needAllocate);
+    uint64_t t1 = FrameClock();
 
     if(w->needAllocate)
         w->needAllocate = false;
 
-    d.surface_damage_func(win->wl_surface, 0, 0,
-            buffer->width, buffer->height);
+    DamageBuffer(win, 0, 0, buffer->width, buffer->height);
+    win->drawnPixels += buffer->width * buffer->height;
+    win->damagedPixels += buffer->width * buffer->height;
 
-    wl_surface_attach(win->wl_surface, buffer->wl_buffer, 0, 0);
+    if(!d.headless) {
+        wl_surface_attach(win->wl_surface, GetAttachBuffer(win), 0, 0);
+        AddFeedback(win);
 
-    // I think this, wl_surface_commit(), needs to be last.  The order of
-    // the other functions may not matter much.
-    wl_surface_commit(win->wl_surface);
+        // I think this, wl_surface_commit(), needs to be last.  The
+        // order of the other functions may not matter much.
+        wl_surface_commit(win->wl_surface);
+    }
+
+    AddFrameRecord(win, layout, t1 - t0, t1,
+            buffer->width * buffer->height);
 }
 
 
@@ -138,7 +154,7 @@ static const struct xdg_surface_listener xdg_surface_listener = {
 static inline void AddWindow(struct PnWindow *win,
         struct PnWindow *last, struct PnWindow **lastPtr) {
 
-    DASSERT(d.wl_display);
+    DASSERT(HaveDisplay());
     DASSERT(!win->next);
     DASSERT(!win->prev);
 
@@ -156,7 +172,7 @@ static inline void AddWindow(struct PnWindow *win,
 static inline void RemoveWindow(struct PnWindow *win,
         struct PnWindow *last, struct PnWindow **lastPtr) {
 
-    DASSERT(d.wl_display);
+    DASSERT(HaveDisplay());
     DASSERT(last);
 
     if(win->next) {
@@ -191,13 +207,58 @@ static void frame_new(struct PnWindow *win,
     wl_callback_destroy(cb);
     win->wl_callback = 0;
 
+    FrameDone(win, a);
+}
+
+// The rest of the frame callback, from a wl_callback or from the
+// headless synthetic clock (see headless.c).  msec is the time stamp in
+// milliseconds.
+//
+void FrameDone(struct PnWindow *win, uint32_t msec) {
+
+    DASSERT(win);
+
+    if(win->haveDrawn && win->haveDrawn < 2)
+        ++win->haveDrawn;
+
+    FrameCallbackTime(win, msec);
+
+    if(PaceFrame(win))
+        // We'll draw a little later from a timer, closer to when the
+        // compositor needs the frame.  See presentation.c.
+        return;
+
+    _pnWindow_drawFrame(win);
+}
+
+// Draw what needs drawing in the window, from a wl_callback or a frame
+// pacing timer.
+//
+void _pnWindow_drawFrame(struct PnWindow *win) {
+
+    DASSERT(win);
+    DASSERT(HaveSurface(win));
+
+    // Motion callbacks can queue drawing, so get them in this frame.
+    FlushPointerMotion();
+    if(!HaveSurface(win))
+        // A motion callback hid it.
+        return;
+
+    uint64_t t = FrameClock();
+
+    if(win->checkOpaque && CheckOpaque(win))
+        // The pixel format changed, so we draw all of it in new buffers.
+        win->needDraw = true;
+
     if(win->needDraw)
         DrawAll(win, 0);
     else if(win->dqWrite->first)
         DrawFromQueue(win);
+    else
+        return;
 
-    if(win->haveDrawn && win->haveDrawn < 2)
-        ++win->haveDrawn;
+    AddDrawTime(win, t);
 }
 
 
@@ -360,6 +421,10 @@ struct PnWindow *_pnWindow_createFull(struct PnWidget *pWidget,
 
     win->buffer.pixels = MAP_FAILED;
     win->buffer.fd = -1;
+    for(uint32_t i = 0; i < PN_MAX_SWAP_BUFFERS; ++i) {
+        win->swapBuffers[i].buffer.pixels = MAP_FAILED;
+        win->swapBuffers[i].buffer.fd = -1;
+    }
 
     win->dqWrite = win->drawQueues;
     win->dqRead = win->drawQueues + 1;
@@ -369,15 +434,20 @@ struct PnWindow *_pnWindow_createFull(struct PnWidget *pWidget,
     win->widget.align = align;
     win->widget.backgroundColor = PN_WINDOW_BGCOLOR;
     win->widget.window = win;
+    win->checkOpaque = true;
 
     InitSurface(&win->widget, numColumns, numRows, 0, 0);
 
-    if(InitWaylandWindow(win))
+    if(d.headless)
+        // There are no Wayland objects to make.  We draw it all at the
+        // first frame after it's shown.
+        win->needDraw = true;
+    else if(InitWaylandWindow(win))
         goto fail;
 
     switch(win->widget.type & (TOPLEVEL | POPUP)) {
         case TOPLEVEL:
-            if(InitToplevel(win))
+            if(!d.headless && InitToplevel(win))
                 goto fail;
             break;
         case POPUP:
@@ -432,7 +502,15 @@ bool pnWindow_show(struct PnWidget *w) {
     if(w->type & POPUP)
         return pnPopup_show(w, win->popup.x, win->popup.y);
 
-    DASSERT(win->wl_surface);
+    if(d.headless && !win->headlessShown) {
+        // This is like the first xdg_surface configure event.
+        win->headlessShown = true;
+        win->needDraw = true;
+        if(!w->allocation.width || !w->allocation.height)
+            w->needAllocate = true;
+    }
+
+    DASSERT(HaveSurface(win));
 
     pnWidget_queueDraw(w, false);
     return false; // success
@@ -442,7 +520,7 @@ bool pnWindow_show(struct PnWidget *w) {
 void _pnWindow_destroy(struct PnWidget *w) {
 
     DASSERT(w);
-    DASSERT(d.wl_display);
+    DASSERT(HaveDisplay());
     ASSERT(w->type & (TOPLEVEL | POPUP));
 
     struct PnWindow *win = (void *) w;
@@ -488,7 +566,12 @@ void _pnWindow_destroy(struct PnWidget *w) {
     if(win->wl_callback)
         wl_callback_destroy(win->wl_callback);
 
+    StopFrameTiming(win);
+
+    FreeFindIndex(win);
+
     // Make sure buffer is freed up.
+    FreeSwapBuffers(win);
     FreeBuffer(&win->buffer);
 
 
@@ -525,7 +608,17 @@ bool _pnWindow_addCallback(struct PnWindow *win) {
 
     DASSERT(win);
 
-    if(win->wl_callback) return false;
+    if(win->wl_callback || win->headlessFrame || win->pacingPending)
+        // We will draw when we get the wl_callback, or when the frame
+        // pacing timer goes off.
+        return false;
+
+    if(d.headless) {
+        // We draw at the next tick of the synthetic clock, in
+        // pnDisplay_dispatch().
+        win->headlessFrame = true;
+        return false;
+    }
 
     win->wl_callback = wl_surface_frame(win->wl_surface);
     if(!win->wl_callback) {
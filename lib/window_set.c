@@ -34,6 +34,164 @@ void pnWindow_setShrinkWrapped(struct PnWidget *widget) {
 }
 
 
+// Set the number of wl_buffers that we switch between to show the
+// window.  The default, num < 2, is to use one buffer that we draw to
+// while the compositor may be reading it.  With num = 2 or 3 (max) we
+// never draw to a buffer that the compositor has not released.
+//
+void pnWindow_setNumBuffers(struct PnWidget *w, uint32_t num) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    struct PnWindow *win = (void *) w;
+
+    if(num < 2)
+        // Just one buffer, PnWindow::buffer, that is drawn to and
+        // attached.
+        num = 0;
+    else if(num > PN_MAX_SWAP_BUFFERS)
+        num = PN_MAX_SWAP_BUFFERS;
+
+    if(num == win->numSwapBuffers) return;
+
+    if(!num && win->pixelFormat == PnPixelFormat_RGB565) {
+        // The 16 bit pixels only live in the swapchain buffers.
+        NOTICE("No swapchain, so the window pixel format goes from "
+                "RGB565 to auto");
+        win->pixelFormat = PnPixelFormat_auto;
+    }
+
+    FreeSwapBuffers(win);
+    win->numSwapBuffers = num;
+
+    if(HaveBuffer(&win->buffer)) {
+        // We are showing.  The new buffers will need all the pixels.
+        win->needDraw = true;
+        _pnWindow_addCallback(win);
+    }
+}
+
+
+// With pool = true the window's shared memory buffers are over-allocated
+// so that resizing the window (like with a mouse drag) does not
+// unmap/remap the memory for every new window size.  It uses more
+// memory.
+//
+void pnWindow_setBufferPool(struct PnWidget *w, bool pool) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    ((struct PnWindow *) w)->bufferPool = pool;
+}
+
+
+void pnWindow_setPixelFormat(struct PnWidget *w,
+        enum PnPixelFormat format) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    ASSERT(format <= PnPixelFormat_RGB565);
+    struct PnWindow *win = (void *) w;
+
+    if(format == PnPixelFormat_RGB565) {
+        if(!HaveShmFormat(WL_SHM_FORMAT_RGB565))
+            // We'll still use the swapchain with XRGB8888.
+            NOTICE("The compositor does not have RGB565 pixels");
+        if(!win->numSwapBuffers)
+            // The 16 bit pixels only live in the swapchain buffers.
+            pnWindow_setNumBuffers(w, 2);
+    }
+
+    if(win->pixelFormat == format) return;
+    win->pixelFormat = format;
+
+    if(HaveBuffer(&win->buffer)) {
+        // The next draw remakes the buffers with the new format.
+        win->needDraw = true;
+        _pnWindow_addCallback(win);
+    }
+}
+
+
+// Set the most rectangles of damage that we tell the compositor about
+// for each frame.  More than that and we send the bounding box of them
+// all.
+//
+void pnWindow_setMaxDamageRects(struct PnWidget *w, uint32_t num) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+
+    if(num < 1)
+        num = 1;
+    else if(num > PN_MAX_DAMAGE_RECTS)
+        num = PN_MAX_DAMAGE_RECTS;
+    ((struct PnWindow *) w)->maxDamageRects = num;
+}
+
+// Get the total number of pixels that widgets drew, and the total number
+// that we told the compositor changed (damaged), since the window was
+// created.  Either pointer may be 0.
+//
+void pnWindow_getPixelCounts(const struct PnWidget *w,
+        uint64_t *drawn, uint64_t *damaged) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    const struct PnWindow *win = (const void *) w;
+
+    if(drawn) *drawn = win->drawnPixels;
+    if(damaged) *damaged = win->damagedPixels;
+}
+
+
+// Turn on frame pacing with marginUsec > 0.  Queued widget draws are put
+// off until the draw time estimate plus marginUsec microseconds before
+// the next predicted monitor refresh; so that widgets, like scope plots,
+// draw the newest data they have.  The margin is for the compositor to
+// get the frame composited.  marginUsec = 0 turns pacing off.
+//
+// Frame pacing uses a timer in the main loop of pnDisplay_run().
+//
+void pnWindow_setFramePacing(struct PnWidget *w, uint32_t marginUsec) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    struct PnWindow *win = (void *) w;
+
+    if(marginUsec && InitFramePacing()) {
+        NOTICE("Frame pacing is not available");
+        marginUsec = 0;
+    }
+    win->pacingMargin = marginUsec * 1000ULL;
+}
+
+// Get the time that the last frame was shown and the monitor refresh
+// period, in nanoseconds from CLOCK_MONOTONIC (the compositor's
+// presentation clock).  Either pointer may be 0.  Returns true if the
+// compositor does not have presentation time feedback, in which case
+// the values are estimates from wl_callback events.
+//
+bool pnWindow_getPresentTime(const struct PnWidget *w,
+        uint64_t *presentTime, uint64_t *refresh) {
+
+    DASSERT(w);
+    ASSERT((w->type & TOPLEVEL) || (w->type & POPUP));
+    const struct PnWindow *win = (const void *) w;
+
+    if(d.wp_presentation) {
+        if(presentTime) *presentTime = MonotonicTime(win->presentTime);
+        if(refresh) *refresh = win->refresh ?
+                win->refresh : win->callbackRefresh;
+        return false;
+    }
+
+    if(presentTime) *presentTime = MonotonicTime(win->callbackTime);
+    if(refresh) *refresh = win->callbackRefresh;
+    return true;
+}
+
+
 void pnWindow_setDestroy(struct PnWidget *w,
         void (*destroy)(struct PnWidget *window, void *userData),
         void *userData) {
@@ -48,9 +206,13 @@ void pnWindow_setDestroy(struct PnWidget *w,
 }
 
 
+// In headless mode there's no compositor to ask for these window states,
+// so these do nothing.
+
 void pnWindow_setMinimized(struct PnWidget *win) {
     DASSERT(win);
     ASSERT(win->type & TOPLEVEL, "Not a toplevel window");
+    if(d.headless) return;
     DASSERT(((struct PnWindow *)win)->toplevel.xdg_toplevel);
     xdg_toplevel_set_minimized(((struct PnWindow *)win)
             ->toplevel.xdg_toplevel);
@@ -59,6 +221,7 @@ void pnWindow_setMinimized(struct PnWidget *win) {
 void pnWindow_setMaximized(struct PnWidget *win) {
     DASSERT(win);
     ASSERT(win->type & TOPLEVEL, "Not a toplevel window");
+    if(d.headless) return;
     DASSERT(((struct PnWindow *)win)->toplevel.xdg_toplevel);
     xdg_toplevel_set_maximized(((struct PnWindow *)win)
             ->toplevel.xdg_toplevel);
@@ -67,6 +230,7 @@ void pnWindow_setMaximized(struct PnWidget *win) {
 void pnWindow_unsetMaximized(struct PnWidget *win) {
     DASSERT(win);
     ASSERT(win->type & TOPLEVEL, "Not a toplevel window");
+    if(d.headless) return;
     DASSERT(((struct PnWindow *)win)->toplevel.xdg_toplevel);
     xdg_toplevel_unset_maximized(((struct PnWindow *)win)
             ->toplevel.xdg_toplevel);
@@ -75,6 +239,7 @@ void pnWindow_unsetMaximized(struct PnWidget *win) {
 void pnWindow_setFullscreen(struct PnWidget *win) {
     DASSERT(win);
     ASSERT(win->type & TOPLEVEL, "Not a toplevel window");
+    if(d.headless) return;
     DASSERT(((struct PnWindow *)win)->toplevel.xdg_toplevel);
     xdg_toplevel_set_fullscreen(((struct PnWindow *)win)
             ->toplevel.xdg_toplevel, 0);
@@ -83,6 +248,7 @@ void pnWindow_setFullscreen(struct PnWidget *win) {
 void pnWindow_unsetFullscreen(struct PnWidget *win) {
     DASSERT(win);
     ASSERT(win->type & TOPLEVEL, "Not a toplevel window");
+    if(d.headless) return;
     DASSERT(((struct PnWindow *)win)->toplevel.xdg_toplevel);
     xdg_toplevel_unset_fullscreen(((struct PnWindow *)win)
             ->toplevel.xdg_toplevel);
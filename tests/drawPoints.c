@@ -0,0 +1,173 @@
+// Check that pnPlot_drawPoints(), pnPlot_drawSamples(), and friends draw
+// the same beam scope pixels as calling pnPlot_drawPoint() for each
+// point, and run them with a Cairo scope.  This runs in headless mode,
+// so it needs no Wayland compositor.
+
+#include <signal.h>
+#include <stdlib.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_POINTS  (3001) // not a multiple of 4
+#define NUM_FRAMES  (20)
+#define NUM_MODES   (5)
+
+// The uniform x values for pnPlot_drawSamples().
+#define X0  (-1.1)
+#define DX  (2.2/NUM_POINTS)
+
+// x0,y0,x1,y1,...  They are floats so that pnPlot_drawPointsf() gets
+// the same values.
+static float xy[2*NUM_POINTS];
+static double x[NUM_POINTS], y[NUM_POINTS];
+static float xf[NUM_POINTS], yf[NUM_POINTS];
+static double xyd[2*NUM_POINTS];
+
+static uint32_t frame = 0, mode;
+
+
+static bool OnePlot(struct PnWidget *g, struct PnPlot *p, void *userData,
+        double xMin, double xMax, double yMin, double yMax) {
+
+    for(uint32_t i = 0; i < NUM_POINTS; ++i)
+        pnPlot_drawPoint(p, x[i], y[i]);
+    return false;
+}
+
+static bool BatchPlot(struct PnWidget *g, struct PnPlot *p,
+        void *userData,
+        double xMin, double xMax, double yMin, double yMax) {
+
+    switch(mode) {
+        case 0:
+            pnPlot_drawPoints(p, x, y, NUM_POINTS);
+            break;
+        case 1:
+            pnPlot_drawPointsStrided(p, xyd, 2, xyd + 1, 2, NUM_POINTS);
+            break;
+        case 2:
+            // In two parts.
+            pnPlot_drawPointsf(p, xf, yf, 7);
+            pnPlot_drawPointsf(p, xf + 7, yf + 7, NUM_POINTS - 7);
+            break;
+        case 3:
+            pnPlot_drawSamples(p, X0, DX, yf, PnSampleType_float,
+                    NUM_POINTS);
+            break;
+        case 4:
+            pnPlot_drawSamples(p, X0, DX, y, PnSampleType_double, 100);
+            pnPlot_drawSamples(p, X0 + 100 * DX, DX, y + 100,
+                    PnSampleType_double, NUM_POINTS - 100);
+            break;
+    }
+    return false;
+}
+
+
+static struct PnWidget *Window(
+        bool (*plot)(struct PnWidget *, struct PnPlot *, void *,
+            double, double, double, double),
+        struct PnWidget **graph) {
+
+    struct PnWidget *win = pnWindow_create(0, 0, 0, 0, 0, PnLayout_LR, 0,
+            PnExpand_HV);
+    ASSERT(win);
+    pnWindow_setPreferredSize(win, 300, 200);
+    struct PnWidget *g = pnGraph_create(win, 90, 70, 0, PnExpand_HV);
+    ASSERT(g);
+    pnGraph_setView(g, -1.0, 1.0, -1.0, 1.0);
+    // maxPoints = 0 so the beam does not fade.
+    ASSERT(pnScopePlot_createWithBeam(g, 0, 1, plot, 0));
+    ASSERT(!pnWindow_show(win));
+    *graph = g;
+    return win;
+}
+
+static inline double Rand(void) {
+    // From -1.2 to 1.2, so some points are culled.
+    return 2.4 * rand()/((double) RAND_MAX) - 1.2;
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    srand(2);
+
+    struct PnWidget *g1, *g2, *g3;
+    struct PnWidget *w1 = Window(OnePlot, &g1);
+    struct PnWidget *w2 = Window(BatchPlot, &g2);
+
+    // And a Cairo scope, just to run it.
+    struct PnWidget *w3 = pnWindow_create(0, 0, 0, 0, 0, PnLayout_LR, 0,
+            PnExpand_HV);
+    ASSERT(w3);
+    g3 = pnGraph_create(w3, 90, 70, 0, PnExpand_HV);
+    ASSERT(g3);
+    ASSERT(pnScopePlot_create(g3, BatchPlot, 0));
+    ASSERT(!pnWindow_show(w3));
+
+    for(; frame < NUM_FRAMES; ++frame) {
+
+        // The pnPlot_drawSamples() modes are last; see the diff below.
+        mode = frame * NUM_MODES / NUM_FRAMES;
+        bool samples = (mode >= 3);
+
+        for(uint32_t i = 0; i < NUM_POINTS; ++i) {
+            xy[2*i] = Rand();
+            xy[2*i+1] = Rand();
+            xyd[2*i] = x[i] = xf[i] = xy[2*i];
+            xyd[2*i+1] = y[i] = yf[i] = xy[2*i+1];
+            if(samples)
+                x[i] = X0 + i * DX;
+        }
+
+        pnWidget_queueDraw(g1, false);
+        pnWidget_queueDraw(g2, false);
+        pnWidget_queueDraw(g3, false);
+        pnWindow_isDrawnReset(w1);
+        pnWindow_isDrawnReset(w2);
+        pnWindow_isDrawnReset(w3);
+        while(!pnWindow_isDrawn(w1) || !pnWindow_isDrawn(w2) ||
+                !pnWindow_isDrawn(w3))
+            ASSERT(pnDisplay_dispatch());
+
+        uint32_t width1, height1, stride1, width2, height2, stride2;
+        const uint32_t *p1 = pnWindow_getPixels(w1,
+                &width1, &height1, &stride1);
+        const uint32_t *p2 = pnWindow_getPixels(w2,
+                &width2, &height2, &stride2);
+        ASSERT(p1 && p2);
+        ASSERT(width1 == width2 && height1 == height2);
+
+        uint32_t diff = 0;
+        for(uint32_t j = 0; j < height1; ++j)
+            for(uint32_t i = 0; i < width1; ++i)
+                if(p1[j*stride1 + i] != p2[j*stride2 + i])
+                    ++diff;
+        // pnPlot_drawSamples() adds up the x pixel positions in fixed
+        // point, so once in a long while a sample that is within a
+        // millionth of a pixel of the edge of a pixel column lands in
+        // the next column.  We let that go.  The other ones must be the
+        // same.  The beam does not fade, so these stay in the frames
+        // after it.
+        ASSERT(diff <= (samples ? 4 : 0), "frame %" PRIu32
+                " has %" PRIu32 " pixels that differ", frame, diff);
+    }
+
+    pnWidget_destroy(w1);
+    pnWidget_destroy(w2);
+    pnWidget_destroy(w3);
+
+    return 0;
+}
@@ -108,6 +108,55 @@ int draw1(struct PnWidget *surface, uint32_t *pixels,
     return 1;
 }
 
+#ifdef RECT
+#define MARKER  (12)
+
+static void Fill(uint32_t *pixels, uint32_t stride, uint32_t color,
+        uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+
+    for(uint32_t j = y; j < y + h; ++j)
+        for(uint32_t i = x; i < x + w; ++i)
+            pixels[j * stride + i] = color;
+}
+
+// Draw just the parts of the widget that the marker moved out of and
+// into, and queue the next move with pnWidget_queueDrawRect().
+//
+static
+int draw2(struct PnWidget *surface, uint32_t *pixels,
+            uint32_t w, uint32_t h, uint32_t stride/*4 bytes*/,
+            void *userData) {
+
+    static uint32_t markerX = 0;
+
+    if(w <= MARKER || h <= MARKER) return 0;
+
+    struct PnAllocation a;
+    pnWidget_getAllocation(surface, &a);
+    const struct PnAllocation *r;
+    uint32_t n = pnWidget_getDirtyRects(surface, &r);
+
+    if(!n)
+        Fill(pixels, stride, 0xCC55AA99, 0, 0, w, h);
+    for(uint32_t i = 0; i < n; ++i)
+        // The rectangles are in window coordinates.
+        Fill(pixels, stride, 0xCC55AA99, r[i].x - a.x, r[i].y - a.y,
+                r[i].width, r[i].height);
+
+    if(markerX > w - MARKER)
+        markerX = 0;
+    Fill(pixels, stride, 0xFFFF0000, markerX, h/2, MARKER, MARKER);
+
+    // Where the marker is now, and where it will be next.
+    pnWidget_queueDrawRect(surface, a.x + markerX, a.y + h/2,
+            MARKER, MARKER);
+    markerX = (markerX + 2) % (w - MARKER);
+    pnWidget_queueDrawRect(surface, a.x + markerX, a.y + h/2,
+            MARKER, MARKER);
+
+    return 0;
+}
+#else
 static
 int draw2(struct PnWidget *surface, uint32_t *pixels,
             uint32_t w, uint32_t h, uint32_t stride/*4 bytes*/,
@@ -130,6 +179,7 @@ int draw2(struct PnWidget *surface, uint32_t *pixels,
 
     return 0;
 }
+#endif
 
 
 int main(int argc, char **argv) {
@@ -161,6 +211,18 @@ int main(int argc, char **argv) {
     pnWidget_setDraw(w, draw2, 0);
 
     pnWindow_setPreferredSize(win, 1100, 900);
+#ifdef SWAPCHAIN
+    // Switch between 3 wl_buffers, copying just the changed pixels.
+    pnWindow_setNumBuffers(win, 3);
+#endif
+#ifdef RGB565
+    // 16 bit pixels for the compositor, if it has them.
+    pnWindow_setPixelFormat(win, PnPixelFormat_RGB565);
+#endif
+#ifdef POOL
+    // Resize the window with the mouse to see how this does.
+    pnWindow_setBufferPool(win, true);
+#endif
     pnWindow_show(win);
 
     Run(win);
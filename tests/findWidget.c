@@ -0,0 +1,153 @@
+// Check that pnWindow_getWidgetAt() finds the right leaf widget at every
+// pixel of a window with random containers, grids, and leaves, before
+// and after the widgets move.  This runs in headless mode, so it needs
+// no Wayland compositor.
+
+#include <signal.h>
+#include <stdlib.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_LEAVES  (400)
+
+static struct PnWidget *leaves[NUM_LEAVES];
+static uint32_t numLeaves = 0;
+
+
+static struct PnWidget *Leaf(struct PnWidget *parent) {
+
+    struct PnWidget *w = pnWidget_create(parent,
+            3 + rand() % 9/*width*/, 3 + rand() % 9/*height*/,
+            PnLayout_None, 0/*align*/, PnExpand_None, 0);
+    ASSERT(w);
+    leaves[numLeaves++] = w;
+    return w;
+}
+
+static void Tree(struct PnWidget *parent, uint32_t depth) {
+
+    while(numLeaves < NUM_LEAVES) {
+        switch(rand() % (depth < 4 ? 8 : 16)) {
+            case 0: {
+                struct PnWidget *c = pnWidget_create(parent,
+                        rand() % 4/*border*/, rand() % 4,
+                        (rand() % 2) ? PnLayout_LR : PnLayout_TB,
+                        rand() % 16/*align*/, PnExpand_None, 0);
+                ASSERT(c);
+                Tree(c, depth + 1);
+                break;
+            }
+            case 1: {
+                struct PnWidget *g = pnWidget_createAsGrid(parent,
+                        rand() % 4, rand() % 4, 0/*align*/,
+                        PnExpand_None, 3, 3, 0);
+                ASSERT(g);
+                for(uint32_t y = 0; y < 3; ++y)
+                    for(uint32_t x = 0; x < 3; ++x)
+                        if(numLeaves < NUM_LEAVES && rand() % 4) {
+                            struct PnWidget *w = pnWidget_createInGrid(g,
+                                    3 + rand() % 9, 3 + rand() % 9,
+                                    PnLayout_None, 0, PnExpand_None,
+                                    x, y, 1, 1, 0);
+                            ASSERT(w);
+                            leaves[numLeaves++] = w;
+                        }
+                break;
+            }
+            case 2:
+                if(depth) return;
+                // fall through
+            default:
+                Leaf(parent);
+        }
+    }
+}
+
+
+static inline bool In(const struct PnAllocation *a, int32_t x, int32_t y) {
+    return (a->x <= x && x < a->x + a->width &&
+            a->y <= y && y < a->y + a->height);
+}
+
+// Look at every pixel in the window.
+static void Check(struct PnWidget *win) {
+
+    struct PnAllocation w, a;
+    pnWidget_getAllocation(win, &w);
+    ASSERT(w.width && w.height);
+
+    for(int32_t y = 0; y < w.height; ++y)
+        for(int32_t x = 0; x < w.width; ++x) {
+            struct PnWidget *found = pnWindow_getWidgetAt(win, x, y);
+            ASSERT(found);
+            pnWidget_getAllocation(found, &a);
+            ASSERT(In(&a, x, y));
+            // If x,y is in a leaf widget, it must be the one we found.
+            for(uint32_t i = 0; i < numLeaves; ++i) {
+                pnWidget_getAllocation(leaves[i], &a);
+                if(In(&a, x, y)) {
+                    ASSERT(found == leaves[i]);
+                    break;
+                }
+            }
+        }
+
+    ASSERT(!pnWindow_getWidgetAt(win, -1, 0));
+    ASSERT(!pnWindow_getWidgetAt(win, 0, w.height));
+}
+
+static void Frame(struct PnWidget *win) {
+
+    pnWindow_isDrawnReset(win);
+    while(!pnWindow_isDrawn(win))
+        ASSERT(pnDisplay_dispatch());
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    srand(1);
+
+    struct PnWidget *win = pnWindow_create(0, 2/*border*/, 2, 0, 0,
+            PnLayout_TB, 0, PnExpand_HV);
+    ASSERT(win);
+    Tree(win, 0);
+
+    ASSERT(!pnWindow_show(win));
+    Frame(win);
+    Check(win);
+
+    // Hide some leaves so the widgets move, and the find index is
+    // rebuilt.
+    for(uint32_t i = 0; i < numLeaves; i += 7) {
+        pnWidget_show(leaves[i], false);
+        leaves[i] = leaves[--numLeaves];
+    }
+    pnWidget_queueDraw(win, true/*allocate*/);
+    Frame(win);
+    Check(win);
+
+    // Destroy some leaves.
+    for(uint32_t i = 0; i < numLeaves; i += 5) {
+        pnWidget_destroy(leaves[i]);
+        leaves[i] = leaves[--numLeaves];
+    }
+    pnWidget_queueDraw(win, true/*allocate*/);
+    Frame(win);
+    Check(win);
+
+    pnWidget_destroy(win);
+
+    return 0;
+}
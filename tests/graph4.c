@@ -137,6 +137,11 @@ int main(void) {
             PnExpand_HV);
     ASSERT(win);
     pnWindow_setPreferredSize(win, 1650, 450);
+#ifdef THREADS
+    // Graphs that get queued to draw (from zooming and panning with the
+    // mouse) are drawn in parallel.
+    pnDisplay_setDrawThreads(4);
+#endif
 
     MakeGraph(Plot);
     MakeGraph(Plot2);
@@ -0,0 +1,168 @@
+// Draw widgets in headless mode, with no Wayland compositor, read back
+// the pixels, and inject pointer events.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <linux/input-event-codes.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define WIDTH   (40)
+#define HEIGHT  (30)
+
+
+static
+int draw(struct PnWidget *w, uint32_t *pixels,
+            uint32_t width, uint32_t height, uint32_t stride/*4 bytes*/,
+            void *userData) {
+
+    uint32_t color = *(uint32_t *) userData;
+
+    for(uint32_t y = 0; y < height; ++y)
+        for(uint32_t x = 0; x < width; ++x)
+            pixels[y * stride + x] = color;
+    return 0;
+}
+
+static uint32_t enters = 0, presses = 0, releases = 0;
+
+static
+bool enter(struct PnWidget *w, uint32_t x, uint32_t y, void *userData) {
+    ++enters;
+    return true; // take focus
+}
+
+static
+void leave(struct PnWidget *w, void *userData) {
+}
+
+static uint32_t motions = 0;
+static int32_t motionX, motionY;
+
+static
+bool motion(struct PnWidget *w, int32_t x, int32_t y, void *userData) {
+    ++motions;
+    motionX = x;
+    motionY = y;
+    return true;
+}
+
+static
+bool press(struct PnWidget *w, uint32_t which, int32_t x, int32_t y,
+        void *userData) {
+    ASSERT(which == BTN_LEFT);
+    ++presses;
+    return true; // grab
+}
+
+static
+bool release(struct PnWidget *w, uint32_t which, int32_t x, int32_t y,
+        void *userData) {
+    ++releases;
+    return true;
+}
+
+
+static uint32_t Pixel(struct PnWidget *win, struct PnWidget *w) {
+
+    uint32_t width, height, stride;
+    const uint32_t *pixels = pnWindow_getPixels(win, &width, &height,
+            &stride);
+    ASSERT(pixels);
+
+    struct PnAllocation a;
+    pnWidget_getAllocation(w, &a);
+    ASSERT(a.x + a.width <= width);
+    ASSERT(a.y + a.height <= height);
+    return pixels[(a.y + a.height/2) * stride + a.x + a.width/2];
+}
+
+static void Frame(struct PnWidget *win) {
+
+    pnWindow_isDrawnReset(win);
+    while(!pnWindow_isDrawn(win))
+        ASSERT(pnDisplay_dispatch());
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    struct PnWidget *win = pnWindow_create(0, 0, 0,
+            0/*x*/, 0/*y*/, PnLayout_LR/*layout*/, 0,
+            PnExpand_None);
+    ASSERT(win);
+
+    uint32_t colors[2] = { 0xFFFF0000, 0xFF00FF00 };
+    struct PnWidget *w[2];
+
+    for(uint32_t i = 0; i < 2; ++i) {
+        w[i] = pnWidget_create(win, WIDTH, HEIGHT,
+                0/*layout*/, 0/*align*/, PnExpand_None, 0);
+        ASSERT(w[i]);
+        pnWidget_setDraw(w[i], draw, colors + i);
+    }
+
+    pnWidget_setEnter(w[1], enter, 0);
+    pnWidget_setLeave(w[1], leave, 0);
+    pnWidget_setPress(w[1], press, 0);
+    pnWidget_setMotion(w[1], motion, 0);
+    pnWidget_setRelease(w[1], release, 0);
+
+    // Nothing is drawn until it's shown.
+    ASSERT(!pnWindow_getPixels(win, 0, 0, 0));
+
+    ASSERT(!pnWindow_show(win));
+    Frame(win);
+
+    ASSERT(Pixel(win, w[0]) == colors[0]);
+    ASSERT(Pixel(win, w[1]) == colors[1]);
+
+    // Draw one widget from the draw queue.
+    colors[0] = 0xFF0000FF;
+    pnWidget_queueDraw(w[0], false);
+    ASSERT(pnDisplay_dispatch());
+    ASSERT(Pixel(win, w[0]) == colors[0]);
+    ASSERT(Pixel(win, w[1]) == colors[1]);
+
+    struct PnAllocation a;
+    pnWidget_getAllocation(w[1], &a);
+    ASSERT(!pnWindow_injectPointerMotion(win,
+                a.x + a.width/2, a.y + a.height/2));
+    ASSERT(enters == 1);
+
+    // We are not in pnDisplay_run() or pnDisplay_dispatch(), so nothing
+    // would flush a motion saved for later.  Each one must get to the
+    // motion callback now.
+    for(uint32_t i = 1; i <= 3; ++i) {
+        uint32_t n = motions;
+        ASSERT(!pnWindow_injectPointerMotion(win, a.x + i, a.y + i));
+        ASSERT(motions == n + 1);
+        ASSERT(motionX == a.x + i && motionY == a.y + i,
+                "motion at %" PRIi32 ",%" PRIi32, motionX, motionY);
+    }
+    ASSERT(enters == 1);
+    ASSERT(!pnDisplay_injectPointerButton(BTN_LEFT, true));
+    ASSERT(!pnDisplay_injectPointerButton(BTN_LEFT, false));
+    ASSERT(presses == 1);
+    ASSERT(releases == 1);
+    ASSERT(!pnDisplay_injectPointerLeave());
+
+    struct PnFrameStats stats;
+    pnWindow_getFrameStats(win, &stats);
+    ASSERT(stats.numFrames == 2, "numFrames=%" PRIu64, stats.numFrames);
+
+    pnWidget_destroy(win);
+
+    return 0;
+}
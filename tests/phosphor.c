@@ -0,0 +1,143 @@
+// Check the phosphor (intensity graded) scope plot: points add up on
+// their pixels, the pixels fade out after the points stop, and the
+// colors come from the color table.  This runs in headless mode, so it
+// needs no Wayland compositor.
+
+#include <signal.h>
+#include <stdlib.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_SAMPLES  (500)
+#define DRAW_FRAMES  (5)
+#define NUM_FRAMES   (20)
+
+static uint32_t frame = 0;
+static float samples[NUM_SAMPLES];
+
+
+static bool Plot(struct PnWidget *g, struct PnPlot *p, void *userData,
+        double xMin, double xMax, double yMin, double yMax) {
+
+    if(frame >= DRAW_FRAMES)
+        return false;
+
+    // Four hits on one pixel is full intensity.
+    for(uint32_t i = 0; i < 4; ++i)
+        pnPlot_drawPoint(p, 0.0, 0.0);
+    // And one hit on a lot of pixels.
+    pnPlot_drawSamples(p, -0.9, 1.8/NUM_SAMPLES, samples,
+            PnSampleType_float, NUM_SAMPLES);
+    return false;
+}
+
+static bool NoPlot(struct PnWidget *g, struct PnPlot *p, void *userData,
+        double xMin, double xMax, double yMin, double yMax) {
+
+    return false;
+}
+
+
+static struct PnWidget *Window(
+        bool (*plot)(struct PnWidget *, struct PnPlot *, void *,
+            double, double, double, double),
+        struct PnWidget **graph) {
+
+    struct PnWidget *win = pnWindow_create(0, 0, 0, 0, 0, PnLayout_LR, 0,
+            PnExpand_HV);
+    ASSERT(win);
+    pnWindow_setPreferredSize(win, 300, 200);
+    struct PnWidget *g = pnGraph_create(win, 90, 70, 0, PnExpand_HV);
+    ASSERT(g);
+    pnGraph_setView(g, -1.0, 1.0, -1.0, 1.0);
+    // Half is left after each frame.
+    struct PnPlot *p = pnScopePlot_createWithPhosphor(g, 0.5, 4, plot, 0);
+    ASSERT(p);
+    // The blue byte is the intensity level, so we can read it.
+    uint32_t colors[256];
+    for(uint32_t i = 0; i < 256; ++i)
+        colors[i] = 0xFF000000 | i;
+    pnPlot_setPhosphorColors(p, colors);
+    ASSERT(!pnWindow_show(win));
+    *graph = g;
+    return win;
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    for(uint32_t i = 0; i < NUM_SAMPLES; ++i)
+        samples[i] = 0.5;
+
+    struct PnWidget *g1, *g2;
+    struct PnWidget *w1 = Window(Plot, &g1);
+    struct PnWidget *w2 = Window(NoPlot, &g2);
+
+    uint32_t lastMax = 256;
+
+    for(; frame < NUM_FRAMES; ++frame) {
+
+        pnWidget_queueDraw(g1, false);
+        pnWidget_queueDraw(g2, false);
+        pnWindow_isDrawnReset(w1);
+        pnWindow_isDrawnReset(w2);
+        while(!pnWindow_isDrawn(w1) || !pnWindow_isDrawn(w2))
+            ASSERT(pnDisplay_dispatch());
+
+        uint32_t width1, height1, stride1, width2, height2, stride2;
+        const uint32_t *p1 = pnWindow_getPixels(w1,
+                &width1, &height1, &stride1);
+        const uint32_t *p2 = pnWindow_getPixels(w2,
+                &width2, &height2, &stride2);
+        ASSERT(p1 && p2);
+        ASSERT(width1 == width2 && height1 == height2);
+
+        // The pixels that differ from the graph with no points are the
+        // phosphor pixels.
+        uint32_t diff = 0, max = 0;
+        for(uint32_t j = 0; j < height1; ++j)
+            for(uint32_t i = 0; i < width1; ++i) {
+                uint32_t c = p1[j*stride1 + i];
+                if(c == p2[j*stride2 + i])
+                    continue;
+                ++diff;
+                ASSERT((c & 0xFFFFFF00) == 0xFF000000);
+                if((c & 0xFF) > max)
+                    max = c & 0xFF;
+            }
+
+        if(frame < DRAW_FRAMES) {
+            // Many pixels with one hit and one pixel at full intensity.
+            ASSERT(diff > 50, "frame %" PRIu32 " diff=%" PRIu32,
+                    frame, diff);
+            ASSERT(max == 255, "frame %" PRIu32 " max=%" PRIu32,
+                    frame, max);
+        } else {
+            // They fade out, halving each frame.
+            ASSERT(max < lastMax && (max >= lastMax/2 - 1 || !max),
+                    "frame %" PRIu32 " max=%" PRIu32 " last max=%" PRIu32,
+                    frame, max, lastMax);
+            ASSERT(max || !diff);
+        }
+        lastMax = max?max:1;
+    }
+
+    // All gone.
+    ASSERT(lastMax == 1);
+
+    pnWidget_destroy(w1);
+    pnWidget_destroy(w2);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Post function calls and widget draws from other threads, in headless
+// mode so it needs no Wayland compositor.  Then destroy widgets with
+// draws posted while another thread is posting.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_THREADS  (4)
+#define NUM_POSTS    (10000)
+#define NUM_DESTROYS (1000)
+
+
+static struct PnWidget *win, *widget;
+
+// Only the main thread touches these.
+static uint32_t calls[NUM_THREADS];
+static uint32_t draws = 0, done = 0;
+
+
+static
+int draw(struct PnWidget *w, uint32_t *pixels,
+            uint32_t width, uint32_t height, uint32_t stride/*4 bytes*/,
+            void *userData) {
+    ++draws;
+    return 0;
+}
+
+// Called in the main thread.
+static void Call(uint32_t *count) {
+
+    ++(*count);
+}
+
+static void Start(void *data) {
+}
+
+static void Done(void *data) {
+
+    if(++done < NUM_THREADS) return;
+
+    for(uint32_t i = 0; i < NUM_THREADS; ++i)
+        ASSERT(calls[i] == NUM_POSTS, "calls[%" PRIu32 "]=%" PRIu32,
+                i, calls[i]);
+    // This ends pnDisplay_run().
+    pnWidget_destroy(win);
+}
+
+static uint32_t counted = 0;
+
+static void Count(void *data) {
+
+    ++counted;
+}
+
+static void *CountThread(void *data) {
+
+    for(uint32_t i = 0; i < NUM_POSTS; ++i)
+        ASSERT(!pnDisplay_post(Count, 0));
+    return 0;
+}
+
+static void *Thread(uint32_t *count) {
+
+    for(uint32_t i = 0; i < NUM_POSTS; ++i) {
+        ASSERT(!pnDisplay_post((void (*)(void *)) Call, count));
+        pnWidget_postDraw(widget);
+    }
+    ASSERT(!pnDisplay_post(Done, 0));
+    return 0;
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    win = pnWindow_create(0, 0, 0, 0, 0, PnLayout_LR, 0, PnExpand_None);
+    ASSERT(win);
+    widget = pnWidget_create(win, 20, 20, 0, 0, PnExpand_None, 0);
+    ASSERT(widget);
+    pnWidget_setDraw(widget, draw, 0);
+    ASSERT(!pnWindow_show(win));
+
+    // pnDisplay_run() in headless mode returns if nothing can make more
+    // to draw, and it does not know about the threads until they post.
+    // So we post first.
+    ASSERT(!pnDisplay_post(Start, 0));
+
+    pthread_t threads[NUM_THREADS];
+    for(uint32_t i = 0; i < NUM_THREADS; ++i)
+        ASSERT(0 == pthread_create(threads + i, 0,
+                    (void *(*)(void *)) Thread, calls + i));
+
+    // pnDisplay_run() returns when there are no posts waiting, and the
+    // threads may not be done posting.
+    while(done < NUM_THREADS)
+        ASSERT(!pnDisplay_run());
+
+    for(uint32_t i = 0; i < NUM_THREADS; ++i)
+        ASSERT(0 == pthread_join(threads[i], 0));
+
+    ASSERT(done == NUM_THREADS);
+    // The posted draws of the widget get drawn together.
+    ASSERT(draws < NUM_THREADS * NUM_POSTS);
+
+    // Now destroy widgets that have a draw in the post queue, while
+    // another thread is adding to the queue.  The draw posts must not
+    // refer to the destroyed widgets.
+    win = pnWindow_create(0, 0, 0, 0, 0, PnLayout_LR, 0, PnExpand_None);
+    ASSERT(win);
+    ASSERT(!pnWindow_show(win));
+
+    pthread_t thread;
+    ASSERT(0 == pthread_create(&thread, 0, CountThread, 0));
+
+    for(uint32_t i = 0; i < NUM_DESTROYS; ++i) {
+        widget = pnWidget_create(win, 20, 20, 0, 0, PnExpand_None, 0);
+        ASSERT(widget);
+        pnWidget_setDraw(widget, draw, 0);
+        pnWidget_postDraw(widget);
+        pnWidget_destroy(widget);
+        if(i % 10 == 0)
+            ASSERT(!pnDisplay_run());
+    }
+
+    ASSERT(0 == pthread_join(thread, 0));
+    ASSERT(!pnDisplay_run());
+    ASSERT(counted == NUM_POSTS, "counted=%" PRIu32, counted);
+
+    pnWidget_destroy(win);
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Check that the allocations we get after showing, hiding, and resizing
+// widgets, which usually redo the allocations of just part of the
+// window, are the same as the allocations we get from redoing all of
+// the window.  This runs in headless mode, so it needs no Wayland
+// compositor.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-client.h>
+
+#include "../include/panels.h"
+
+#include "../lib/xdg-shell-protocol.h"
+#include "../lib/xdg-decoration-protocol.h"
+
+#include "../lib/debug.h"
+#include "../lib/display.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_LEAVES   (200)
+#define NUM_CHANGES  (300)
+
+static struct PnWidget *widgets[2*NUM_LEAVES];
+static uint32_t numWidgets = 0, numLeaves = 0;
+static struct PnAllocation allocations[2*NUM_LEAVES];
+
+
+static void Tree(struct PnWidget *parent, uint32_t depth) {
+
+    while(numLeaves < NUM_LEAVES) {
+        struct PnWidget *w;
+        switch(rand() % (depth < 3 ? 6 : 12)) {
+            case 0:
+                w = pnWidget_create(parent,
+                        rand() % 4/*border*/, rand() % 4,
+                        (rand() % 2) ? PnLayout_LR : PnLayout_TB,
+                        rand() % 16/*align*/, rand() % 4/*expand*/, 0);
+                ASSERT(w);
+                widgets[numWidgets++] = w;
+                Tree(w, depth + 1);
+                break;
+            case 1:
+                if(depth) return;
+                // fall through
+            default:
+                w = pnWidget_create(parent,
+                        3 + rand() % 9/*width*/, 3 + rand() % 9/*height*/,
+                        PnLayout_None, 0/*align*/, rand() % 4/*expand*/,
+                        0);
+                ASSERT(w);
+                widgets[numWidgets++] = w;
+                ++numLeaves;
+        }
+    }
+}
+
+static void Frames(void) {
+
+    // In headless mode each dispatch is a frame, and it does not wait.
+    for(uint32_t i = 0; i < 3; ++i)
+        ASSERT(pnDisplay_dispatch());
+}
+
+static void Change(void) {
+
+    struct PnWidget *w = widgets[rand() % numWidgets];
+
+    if(rand() % 2)
+        pnWidget_show(w, w->hidden);
+    else if(w->layout == PnLayout_None)
+        pnWidget_setSize(w, 3 + rand() % 9, 3 + rand() % 9);
+    else
+        pnWidget_setSize(w, rand() % 4, rand() % 4);
+}
+
+// Compare the allocations of the showing widgets after a change with the
+// allocations after redoing all of the window.
+static void Check(struct PnWidget *win) {
+
+    for(uint32_t i = 0; i < numWidgets; ++i)
+        allocations[i] = widgets[i]->allocation;
+
+    pnWidget_queueDraw(win, true/*allocate*/);
+    Frames();
+
+    for(uint32_t i = 0; i < numWidgets; ++i) {
+        const struct PnWidget *w = widgets[i];
+        if(w->culled) continue;
+        const struct PnAllocation *a = allocations + i;
+        ASSERT(!memcmp(a, &w->allocation, sizeof(*a)),
+                "widget %" PRIu32 " %" PRIu32 ",%" PRIu32 " %" PRIu32
+                "x%" PRIu32 " != %" PRIu32 ",%" PRIu32 " %" PRIu32
+                "x%" PRIu32, i, a->x, a->y, a->width, a->height,
+                w->allocation.x, w->allocation.y,
+                w->allocation.width, w->allocation.height);
+    }
+}
+
+static void Run(uint32_t width, uint32_t height) {
+
+    numWidgets = numLeaves = 0;
+
+    struct PnWidget *win = pnWindow_create(0, 2/*border*/, 2, 0, 0,
+            PnLayout_LR, 0, PnExpand_HV);
+    ASSERT(win);
+    if(width)
+        pnWindow_setPreferredSize(win, width, height);
+    Tree(win, 0);
+
+    ASSERT(!pnWindow_show(win));
+    Frames();
+
+    for(uint32_t i = 0; i < NUM_CHANGES; ++i) {
+        Change();
+        Frames();
+        Check(win);
+    }
+
+    pnWidget_destroy(win);
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    srand(1);
+
+    // Shrink wrapped, so nothing is clipped or culled.
+    Run(0, 0);
+    // Larger than it needs, so widgets expand.
+    Run(2000, 1000);
+    // Smaller than it needs, so widgets are clipped, and some are culled.
+    Run(300, 60);
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+// The sample ring with a producer thread and the main thread reading.
+// This needs no display.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define NUM_SAMPLES  (2000000)
+#define RING_SIZE    (4096)
+
+
+static struct PnRing *ring;
+
+
+// Write counting numbers, some in place and some copied.
+static void *Producer(void *data) {
+
+    int32_t count = 0;
+    int32_t buf[100];
+
+    while(count < NUM_SAMPLES) {
+        if(count % 3) {
+            uint32_t n;
+            int32_t *s = pnRing_writeBegin(ring, &n);
+            if(n > NUM_SAMPLES - count)
+                n = NUM_SAMPLES - count;
+            for(uint32_t i = 0; i < n; ++i)
+                s[i] = count++;
+            pnRing_writeEnd(ring, n);
+            continue;
+        }
+        uint32_t n = 100;
+        if(n > NUM_SAMPLES - count)
+            n = NUM_SAMPLES - count;
+        for(uint32_t i = 0; i < n; ++i)
+            buf[i] = count + i;
+        // We keep the ones that did not fit, but they are counted as
+        // dropped.
+        count += pnRing_write(ring, buf, n);
+    }
+    return 0;
+}
+
+static void Check(const int32_t *s, uint32_t num, int32_t *count) {
+
+    for(uint32_t i = 0; i < num; ++i)
+        ASSERT(s[i] == (*count)++, "s[%" PRIu32 "]=%" PRIi32 " not %"
+                PRIi32, i, s[i], *count - 1);
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ring = pnRing_create(PnSampleType_int32, RING_SIZE - 5);
+    ASSERT(ring);
+    ASSERT(pnRing_getSampleType(ring) == PnSampleType_int32);
+
+    pthread_t thread;
+    ASSERT(0 == pthread_create(&thread, 0, Producer, 0));
+
+    int32_t count = 0;
+
+    while(count < NUM_SAMPLES) {
+        const void *first, *second;
+        uint32_t numFirst, numSecond;
+        uint32_t num = pnRing_readBegin(ring, 0, &first, &numFirst,
+                &second, &numSecond);
+        ASSERT(num == numFirst + numSecond);
+        ASSERT(num <= RING_SIZE);
+        // Sometimes read just part of them.
+        if(num > 1 && count % 2) {
+            if(numFirst > num/2)
+                numFirst = num/2;
+            numSecond = 0;
+            num = numFirst;
+        }
+        Check(first, numFirst, &count);
+        Check(second, numSecond, &count);
+        pnRing_readEnd(ring, num);
+    }
+
+    ASSERT(0 == pthread_join(thread, 0));
+    ASSERT(count == NUM_SAMPLES);
+
+    // Now just this thread.  Fill it up, and the rest get dropped.
+    uint64_t dropped = pnRing_getDropped(ring);
+    int32_t buf[RING_SIZE + 10];
+    for(int32_t i = 0; i < RING_SIZE + 10; ++i)
+        buf[i] = count + i;
+    ASSERT(pnRing_write(ring, buf, RING_SIZE + 10) == RING_SIZE);
+    ASSERT(pnRing_getDropped(ring) == dropped + 10);
+
+    // Get the newest 100 and skip the rest.
+    const void *first, *second;
+    uint32_t numFirst, numSecond;
+    ASSERT(pnRing_readBegin(ring, 100, &first, &numFirst,
+                &second, &numSecond) == 100);
+    count += RING_SIZE - 100;
+    Check(first, numFirst, &count);
+    Check(second, numSecond, &count);
+    pnRing_readEnd(ring, 100);
+    ASSERT(pnRing_readBegin(ring, 0, &first, &numFirst,
+                &second, &numSecond) == 0);
+
+    pnRing_destroy(ring);
+
+    return 0;
+}
@@ -34,6 +34,29 @@ bool Plot(struct PnWidget *g, struct PnPlot *p, void *userData,
 }
 
 
+static void PrintStat(const char *name, const struct PnStatSummary *s,
+        double scale) {
+    fprintf(stderr, "  %14s p50=%9.3f p90=%9.3f p99=%9.3f max=%9.3f\n",
+            name, s->p50*scale, s->p90*scale, s->p99*scale, s->max*scale);
+}
+
+// Print the frame statistics before the window goes away.
+static void destroy(struct PnWidget *win, void *userData) {
+
+    struct PnFrameStats s;
+    pnWindow_getFrameStats(win, &s);
+
+    fprintf(stderr, "%" PRIu64 " frames, the last %" PRIu32 ":\n",
+            s.numFrames, s.numSamples);
+    PrintStat("layout ms", &s.layout, 1.0e-6);
+    PrintStat("draw ms", &s.draw, 1.0e-6);
+    PrintStat("commit ms", &s.commit, 1.0e-6);
+    PrintStat("latency ms", &s.latency, 1.0e-6);
+    PrintStat("widgets", &s.widgets, 1.0);
+    PrintStat("damaged pixels", &s.damagedPixels, 1.0);
+}
+
+
 int main(void) {
 
     ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
@@ -43,6 +66,12 @@ int main(void) {
             PnExpand_HV);
     ASSERT(win);
     pnWindow_setPreferredSize(win, 1100, 900);
+    pnWindow_setDestroy(win, destroy, 0);
+#ifdef PACING
+    // Draw the scope as close as we can to when the compositor needs
+    // the frame, leaving it 3 milliseconds.
+    pnWindow_setFramePacing(win, 3000);
+#endif
 
     // The auto 2D plotter grid (graph)
     struct PnWidget *w = pnGraph_create(
@@ -144,6 +144,8 @@ int main(int argc, char **argv) {
     pnWidget_setDraw(w, draw, (void *) (uintptr_t)(argc - 1));
     pnWidget_setConfig(w, config, 0);
     pnWidget_setMotion(w, motion, (void *) (uintptr_t)(argc - 1));
+    // We want every pointer position for the scribble line.
+    pnWidget_setAllMotion(w, true);
 
     pnWindow_show(win);
 
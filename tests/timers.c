@@ -0,0 +1,83 @@
+// Main loop timers, in headless mode so it needs no Wayland compositor.
+
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../include/panels.h"
+#include "../lib/debug.h"
+
+static
+void catcher(int sig) {
+
+    ASSERT(0, "caught signal number %d", sig);
+}
+
+#define MSEC     (1000000ULL) // nanoseconds
+#define PERIOD   (5*MSEC)
+#define NUM      (10)
+
+
+static inline uint64_t Now(void) {
+    struct timespec t;
+    ASSERT(0 == clock_gettime(CLOCK_MONOTONIC, &t));
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static uint64_t start;
+static uint32_t ticks = 0, shots = 0;
+static struct PnWidget *win;
+static struct PnTimer *never;
+
+
+static int Tick(struct PnTimer *timer, void *userData) {
+
+    ++ticks;
+    ASSERT(Now() - start >= ticks * PERIOD);
+    if(ticks < NUM)
+        return 0; // keep going
+    return 1; // remove it
+}
+
+static int Shot(struct PnTimer *timer, void *userData) {
+
+    ++shots;
+    ASSERT(ticks == NUM);
+    ASSERT(Now() - start >= (NUM + 2) * PERIOD);
+    ASSERT(!pnDisplay_removeTimer(never));
+    // This ends pnDisplay_run().
+    pnWidget_destroy(win);
+    return 0;
+}
+
+static int Never(struct PnTimer *timer, void *userData) {
+
+    ASSERT(0, "This timer should have been removed");
+    return 1;
+}
+
+
+int main(void) {
+
+    ASSERT(SIG_ERR != signal(SIGSEGV, catcher));
+
+    ASSERT(!pnDisplay_setHeadless(0));
+
+    win = pnWindow_create(0, 20, 20, 0, 0, PnLayout_None, 0,
+            PnExpand_None);
+    ASSERT(win);
+    ASSERT(!pnWindow_show(win));
+
+    start = Now();
+
+    ASSERT(pnDisplay_addTimer(PERIOD, PERIOD, 0, Tick, 0));
+    ASSERT(pnDisplay_addTimer((NUM + 2) * PERIOD, 0, MSEC, Shot, 0));
+    ASSERT((never = pnDisplay_addTimer(1000 * PERIOD, 0, 0, Never, 0)));
+
+    ASSERT(!pnDisplay_run());
+
+    ASSERT(ticks == NUM);
+    ASSERT(shots == 1);
+
+    return 0;
+}